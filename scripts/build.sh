@@ -1,9 +1,14 @@
 #!/bin/bash
 
+# Set ZIGZAG_DEBUG=1 to compile console output in
+# Set ZIGZAG_STATS=1 to compile hot path counters (stats table) in
+
 mkdir -p build
 cd build
 eosio-cpp \
   -R ../src/ricardian \
   -o zigzag.wasm \
   ../src/zigzag.cpp \
+  ${ZIGZAG_DEBUG:+-DZIGZAG_DEBUG} \
+  ${ZIGZAG_STATS:+-DZIGZAG_STATS} \
   --abigen
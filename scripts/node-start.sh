@@ -49,6 +49,8 @@ echo "Create accounts"
   cleos create account eosio bosio.token EOS5c5WJADXmwzbvBhTs8BrLwYtmopGHF8iWfKiaGM8MwA41T4H9h -p eosio@active &
   # Create ZIG token account
   cleos create account eosio zigtokenhome EOS8Niq2TpkpvrtXx2UUAJgTfaw3zgJr7A9PtAzrcLVBghNnXcPNc -p eosio@active &
+  # Create mock price feed account
+  cleos create account eosio price.feed EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV -p eosio@active &
   # Create smart contract account
   cleos create account eosio zigzag EOS7cwDd4bhNRVYWDB1HV93UoAK2KEUQYmkLwrm589CqUrght1chy -p eosio@active &
   wait && sleep 1
@@ -62,6 +64,13 @@ echo "Publish token contracts"
   wait && sleep 1
 ) >> $LOG_FILE 2>&1
 
+echo "Publish mock price feed"
+(
+  mkdir -p build/pricefeed
+  eosio-cpp -o build/pricefeed/pricefeed.wasm test/contracts/pricefeed/pricefeed.cpp --abigen
+  cleos set contract price.feed build/pricefeed pricefeed.wasm pricefeed.abi -p price.feed@active
+) >> $LOG_FILE 2>&1
+
 echo "Create and issue tokens"
 (
   # Create tokens
@@ -81,7 +90,7 @@ echo "Create and issue tokens"
 
 echo "Publish project"
 (
-  cleos set contract zigzag build zigzag.wasm zigzag.abi -p zigzag@active
+  cleos set contract zigzag ${ZIGZAG_BUILD:-build} zigzag.wasm zigzag.abi -p zigzag@active
   cleos set account permission zigzag active --add-code
 ) >> $LOG_FILE 2>&1
 
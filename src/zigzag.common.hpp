@@ -0,0 +1,162 @@
+#pragma once
+
+#include <eosio/asset.hpp>
+#include <eosio/name.hpp>
+#include <eosio/symbol.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**
+ * Constants and position math shared by the contract and off-chain tools (tools/indexer)
+ *
+ * Everything here works on plain values only, so the indexer reproduces contract results
+ * bit for bit when it applies the same actions in the same order
+ **/
+
+/* Maximum allowed number of oracles **/
+#define MAX_ORACLES eosio::name("max.oracles")
+#define POSITION_DEF eosio::name("position.def")
+#define INTEREST_DEF eosio::name("interest.def")
+#define INTEREST_INT eosio::name("interest.int")
+#define LIQUIDATE_THRESHOLD eosio::name("liquidate.th")
+#define PENALTY eosio::name("penalty")
+#define MANAGER eosio::name("manager")
+#define LIQUIDATE_ACCOUNT eosio::name("liquid.addr")
+#define CRON_ACCOUNT eosio::name("cron.account")
+#define LIQUIDATE_STEP eosio::name("liquid.step")
+#define LIQUIDATE_LIMIT eosio::name("liquid.limit")
+
+#define ZIGZAG_NAME eosio::name("zigtokenhome")
+
+#define DEFAULT_COLLATERAL_SYMBOL "EOS"
+#define ZIG_SYMBOL eosio::symbol("ZIG", 4)
+
+/** Decimal parameter value ("1.5") as double **/
+inline double param_to_double(std::string s) {
+   if (s == "") return 0;
+   std::size_t i = s.find(".");
+   int digits = s.length() - i - 1;
+   s.erase(i, 1);
+   return atoi(s.c_str()) / pow(10, digits);
+}
+
+/** Amount of asset in another symbol at the exchange rate **/
+inline eosio::asset convert_asset(eosio::asset from, eosio::symbol to, double rate) {
+   double amount_from = from.amount / pow(10, from.symbol.precision());
+   double amount_to = amount_from * rate;
+   return eosio::asset(amount_to * pow(10, to.precision()), to);
+}
+
+/** Loan (borrowed + interest) allowed for the collateral at param(position.def) ratio **/
+inline eosio::asset get_loan_limit(const eosio::asset& collateral, double rate, double position_def) {
+   eosio::asset collateral_value = convert_asset(collateral, ZIG_SYMBOL, rate);
+   collateral_value.set_amount(collateral_value.amount / position_def);
+   return collateral_value;
+}
+
+/**
+ * Smallest collateral amount keeping the loan at the ratio, rounded up so the ratio is never undershot
+ * Capped at the collateral of the position, so a huge ratio or a tiny rate can not overflow the asset amount
+ **/
+inline eosio::asset get_required_collateral(const eosio::asset& loan, const eosio::asset& collateral, double rate, double ratio) {
+   double amount_loan = loan.amount / pow(10, loan.symbol.precision());
+   double amount_required = ceil(amount_loan * ratio / rate * pow(10, collateral.symbol.precision()));
+   return amount_required < collateral.amount ? eosio::asset(int64_t(amount_required), collateral.symbol) : collateral;
+}
+
+/** Interest added to the position once per param(interest.int) **/
+inline eosio::asset get_interest(const eosio::asset& borrowed, double interest_rate, eosio::symbol interest_symbol) {
+   return eosio::asset(borrowed.amount * interest_rate, interest_symbol);
+}
+
+/** Collateral value to loan ratio, position is liquidated when it is not above param(liquidate.th) **/
+inline double get_collateral_ratio(const eosio::asset& collateral_in_zig, const eosio::asset& loan) {
+   return (double)collateral_in_zig.amount / (double)loan.amount;
+}
+
+/**
+ * Liquidation order of positions of one collateral, lowest first
+ * All positions share the rate, so collateral to loan amounts order them by ratio without converting,
+ * positions without loan are last
+ **/
+inline double get_liquidation_order(const eosio::asset& collateral, const eosio::asset& loan) {
+   return loan.amount > 0 ? (double)collateral.amount / (double)loan.amount : HUGE_VAL;
+}
+
+/** Partial repayment, interest is repaid first, then borrowed amount **/
+inline void apply_repayment(eosio::asset& interest, eosio::asset& borrowed, int64_t amount) {
+   auto temp_amount_interest = interest.amount;
+   interest.amount -= interest.amount > amount
+      ? amount
+      : interest.amount;
+   if (interest.amount == 0) {
+      auto remaining_amount = amount - temp_amount_interest;
+      borrowed.amount -= borrowed.amount > remaining_amount
+         ? remaining_amount
+         : borrowed.amount;
+   }
+}
+
+/** Repayment of one position from a ZIG transfer, amount 0 takes what is left of the transfer **/
+struct repayment_allocation {
+   eosio::symbol_code collateral;
+   int64_t amount;
+};
+
+/** Positive decimal amount with up to precision digits after the point ("10.5" is 105000 at precision 4) **/
+inline bool parse_amount(const std::string& str, uint8_t precision, int64_t& amount) {
+   size_t point = str.find('.');
+   std::string digits = str.substr(0, point);
+   std::string decimals = point == std::string::npos ? "" : str.substr(point + 1);
+   if (digits.empty() || digits.size() > 12 || decimals.size() > precision) {
+      return false;
+   }
+   amount = 0;
+   for (char c : digits + decimals + std::string(precision - decimals.size(), '0')) {
+      if (c < '0' || c > '9') {
+         return false;
+      }
+      amount = amount * 10 + (c - '0');
+   }
+   return amount > 0;
+}
+
+/**
+ * Repayment memo of a ZIG transfer: one collateral ("EOS") or a comma separated list of collaterals
+ * with optional ZIG amounts ("EOS:10.0000,BOS"). Returns false if memo is malformed or a collateral repeats
+ **/
+inline bool parse_repayment_memo(const std::string& memo, std::vector<repayment_allocation>& allocations) {
+   size_t start = 0;
+   while (true) {
+      size_t end = memo.find(',', start);
+      std::string entry = memo.substr(start, end == std::string::npos ? std::string::npos : end - start);
+      size_t colon = entry.find(':');
+      std::string code = entry.substr(0, colon);
+      if (code.empty() || code.size() > 7) {
+         return false;
+      }
+      for (char c : code) {
+         if (c < 'A' || c > 'Z') {
+            return false;
+         }
+      }
+
+      repayment_allocation allocation{ eosio::symbol_code(code), 0 };
+      if (colon != std::string::npos && !parse_amount(entry.substr(colon + 1), ZIG_SYMBOL.precision(), allocation.amount)) {
+         return false;
+      }
+      for (auto& item : allocations) {
+         if (item.collateral == allocation.collateral) {
+            return false;
+         }
+      }
+      allocations.push_back(allocation);
+
+      if (end == std::string::npos) {
+         return true;
+      }
+      start = end + 1;
+   }
+}
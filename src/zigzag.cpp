@@ -3,6 +3,8 @@
 using namespace eosio;
 
 void zigzag::setparam(name key, std::string value) {
+   STATS_BEGIN(name("setparam"), get_self().value);
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
@@ -35,6 +37,8 @@ void zigzag::setparam(name key, std::string value) {
 
 void zigzag::addcollater(symbol symbol, name account) {
 
+   STATS_BEGIN(name("addcollater"), symbol.code().raw());
+
    struct currency_stats {
       asset    supply;
       asset    max_supply;
@@ -49,38 +53,50 @@ void zigzag::addcollater(symbol symbol, name account) {
    require_auth(get_self());
 
    /** Check if account exists **/
-   check(is_account(account), "Account does not exist");
+   check(is_account(account), error_code::ACCOUNT_NOT_FOUND);
 
    /** Check if there is a token emission on this account **/
    stats statstable(account, symbol.code().raw());
    auto existing = statstable.find(symbol.code().raw());
-   check(existing != statstable.end(), "Token with symbol does not exist");
+   check(existing != statstable.end(), error_code::TOKEN_NOT_FOUND);
 
    /** Check if collateral with this symbol already exists **/
    collateral_index collateral(get_self(), get_self().value);
    auto iterator = collateral.find(symbol.code().raw());
-   check(iterator == collateral.end(), "Collateral already added");
+   check(iterator == collateral.end(), error_code::COLLATERAL_EXISTS);
+
+   /** Find the lowest collateral id not taken by other collaterals **/
+   uint64_t used_ids = get_used_collateral_ids(collateral);
+   uint8_t id = take_collateral_id(used_ids);
 
    /** Create new parameter record with this key if does not exist **/
    collateral.emplace(get_self(), [&](auto& row) {
       row.symbol = symbol;
       row.account = account;
       row.is_active = false;
+      row.id = id;
+      row.settlement_rate = 0;
+      row.check_rate = 0;
    });
 }
 
 void zigzag::setcollater(symbol symbol, bool is_active) {
 
+   STATS_BEGIN(name("setcollater"), symbol.code().raw());
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
    /** Check if collateral with this symbol exists **/
    collateral_index collateral(get_self(), get_self().value);
    auto iterator = collateral.find(symbol.code().raw());
-   check(iterator != collateral.end(), "Collateral does not exist");
+   check(iterator != collateral.end(), error_code::COLLATERAL_NOT_FOUND);
 
-   /** Continue only if status has changed **/
+   /** Collateral in global settlement can not be activated again **/
    const auto& record = *iterator;
+   check(!is_active || record.settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
+
+   /** Continue only if status has changed **/
    if (record.is_active != is_active) {
 
       /** Update collateral status **/
@@ -92,98 +108,120 @@ void zigzag::setcollater(symbol symbol, bool is_active) {
 
 void zigzag::delcollater(symbol symbol) {
 
+   STATS_BEGIN(name("delcollater"), symbol.code().raw());
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
    /** Check if collateral with this symbol exists **/
    collateral_index collateral(get_self(), get_self().value);
    auto iterator = collateral.find(symbol.code().raw());
-   check(iterator != collateral.end(), "Collateral does not exist");
+   check(iterator != collateral.end(), error_code::COLLATERAL_NOT_FOUND);
 
    /** Only allow deleting inactive collaterals **/
    const auto& record = *iterator;
-   check(!record.is_active, "Collateral is active");
+   check(!record.is_active, error_code::COLLATERAL_ACTIVE);
 
    /** TODO: Check for active positions with this collateral **/
 
+   /** Remove collateral from all oracles, so its id can be reused by a new collateral (not migrated one is in no bitmask yet) **/
+   if (record.id.has_value()) {
+      const uint64_t bit = collateral_bit(*record.id);
+      oracle_index oracle(get_self(), get_self().value);
+      for (auto itr = oracle.begin(); itr != oracle.end(); itr++) {
+         STATS_ROWS(1);
+         if (itr->collaterals & bit) {
+            oracle.modify(itr, get_self(), [&](auto& row) {
+               row.collaterals &= ~bit;
+            });
+         }
+      }
+   }
+
+   /** Delete price feed settings **/
+   feed_index feed_table(get_self(), get_self().value);
+   auto feed_iterator = feed_table.find(symbol.code().raw());
+   if (feed_iterator != feed_table.end()) {
+      feed_table.erase(feed_iterator);
+   }
+
    /** Delete collateral **/
    collateral.erase(iterator);
-
-   /** TODO: Modify all oracles to remove this collateral from their list **/
 }
 
 void zigzag::addoracle(name account, std::vector<symbol> symbols) {
 
+   STATS_BEGIN(name("addoracle"), get_self().value);
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
    /** Check if account exists **/
-   check(is_account(account), "Account does not exist");
+   check(is_account(account), error_code::ACCOUNT_NOT_FOUND);
 
    /** Check if oracle with this account already exists **/
    oracle_index oracle(get_self(), get_self().value);
    auto iterator = oracle.find(account.value);
-   check(iterator == oracle.end(), "Oracle already added");
+   check(iterator == oracle.end(), error_code::ORACLE_EXISTS);
 
-   /** Check if all symbols exist in our collateral table **/
-   collateral_index collateral(get_self(), get_self().value);
-   for (auto &symbol : symbols) {
-      auto symbol_iterator = collateral.find(symbol.code().raw());
-      check(symbol_iterator != collateral.end(), "Symbol does not exist");
-   }
+   /** Check if all symbols exist in our collateral table and build their bitmask **/
+   uint64_t collaterals = get_collaterals_mask(symbols);
    
    /** Check number of oracles already in the system and compare them with max.oracles **/
    auto max_oracles = get_param_int(MAX_ORACLES);
    int size = 0;
    for (auto itr = oracle.begin(); itr != oracle.end(); itr++, size++)
       ;
-   check(size < max_oracles, "Too many oracles");
+   STATS_ROWS(size);
+   check(size < max_oracles, error_code::TOO_MANY_ORACLES);
 
    /** Add oracle to the storage **/
    oracle.emplace(get_self(), [&](auto& row) {
       row.account = account;
-      row.symbols = symbols;
+      row.collaterals = collaterals;
    });
 }
 
 void zigzag::setoracle(name account, std::vector<symbol> symbols) {
 
+   STATS_BEGIN(name("setoracle"), get_self().value);
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
    /** Check if oracle with this account exists **/
    oracle_index oracle(get_self(), get_self().value);
    auto iterator = oracle.find(account.value);
-   check(iterator != oracle.end(), "Oracle does not exist");
+   check(iterator != oracle.end(), error_code::ORACLE_NOT_FOUND);
 
-   /** Check if all symbols exist in our collateral table **/
-   collateral_index collateral(get_self(), get_self().value);
-   for (auto &symbol : symbols) {
-      auto symbol_iterator = collateral.find(symbol.code().raw());
-      check(symbol_iterator != collateral.end(), "Symbol does not exist");
-   }
+   /** Check if all symbols exist in our collateral table and build their bitmask **/
+   uint64_t collaterals = get_collaterals_mask(symbols);
 
    /** Update oracle record **/
    oracle.modify(iterator, get_self(), [&](auto& row) {
-      row.symbols = symbols;
+      row.collaterals = collaterals;
    });
 }
 
 void zigzag::deloracle(name account) {
 
+   STATS_BEGIN(name("deloracle"), get_self().value);
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
    /** Check if oracle with this account exists **/
    oracle_index oracle(get_self(), get_self().value);
    auto oracle_iterator = oracle.find(account.value);
-   check(oracle_iterator != oracle.end(), "Oracle does not exist");
+   check(oracle_iterator != oracle.end(), error_code::ORACLE_NOT_FOUND);
 
    /** Delete all rates for all collaterals reported by this oracle **/
    collateral_index collateral(get_self(), get_self().value);
    for (auto collateral_iterator = collateral.begin(); collateral_iterator != collateral.end(); collateral_iterator++) {
+      STATS_ROWS(1);
       rate_index rate_table(get_self(), collateral_iterator->symbol.code().raw());
       for (auto itr = rate_table.begin(); itr != rate_table.end();) {
+         STATS_ROWS(1);
          if (itr->account == oracle_iterator->account) {
             itr = rate_table.erase(itr);
          } else {
@@ -197,6 +235,7 @@ void zigzag::deloracle(name account) {
 }
 
 void zigzag::setrate(name oracle, symbol collateral, double rate) {
+   STATS_BEGIN(name("setrate"), collateral.code().raw());
 
    /** Check oracle and signer are same **/   
    require_auth(oracle);
@@ -204,15 +243,26 @@ void zigzag::setrate(name oracle, symbol collateral, double rate) {
    /** Check if oracle with this account exists **/
    oracle_index oracle_table(get_self(), get_self().value);
    auto oracle_iterator = oracle_table.find(oracle.value);
-   check(oracle_iterator != oracle_table.end(), "Oracle does not exist");
+   check(oracle_iterator != oracle_table.end(), error_code::ORACLE_NOT_FOUND);
    
    /** Check if oracle has symbol **/
-   const auto& record = *oracle_iterator;
-   const auto has_symbol = std::find(record.symbols.begin(), record.symbols.end(), collateral) != record.symbols.end();
-   check(has_symbol, "Symbol is not supported by this oracle");
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   const auto has_symbol = collateral_iterator != collateral_table.end()
+      && collateral_iterator->symbol == collateral
+      && collateral_iterator->id.has_value()
+      && (oracle_iterator->collaterals & collateral_bit(*collateral_iterator->id));
+   check(has_symbol, error_code::SYMBOL_NOT_SUPPORTED);
+
+   /** Rates are frozen during global settlement **/
+   check(collateral_iterator->settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
+
+   /** Oracles do not report rates of collaterals read from price feed **/
+   feed_index feed_table(get_self(), get_self().value);
+   check(feed_table.find(collateral.code().raw()) == feed_table.end(), error_code::FEED_MODE);
 
    /** Check if rate is graten then zero **/
-   check(rate > 0, "Rate must be greater then zero");
+   check(rate > 0, error_code::RATE_NOT_POSITIVE);
 
    /** Try to find rate record **/
    rate_index rate_table(get_self(), collateral.code().raw());
@@ -231,26 +281,79 @@ void zigzag::setrate(name oracle, symbol collateral, double rate) {
          row.account = oracle;
       });
    }
+
+   check_liquidations(collateral_table, collateral_iterator);
+}
+
+void zigzag::setfeed(symbol collateral, name contract, name pair, uint8_t precision, uint32_t max_age, double min_rate, double max_rate) {
+   STATS_BEGIN(name("setfeed"), collateral.code().raw());
+
+   /** Throw if signed by wrong account **/
+   require_auth(get_self());
+
+   /** Check if collateral with this symbol exists **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+
+   feed_index feed_table(get_self(), get_self().value);
+   auto feed_iterator = feed_table.find(collateral.code().raw());
+
+   /** Empty contract switches collateral back to oracle rates **/
+   if (contract == name()) {
+      if (feed_iterator != feed_table.end()) {
+         feed_table.erase(feed_iterator);
+      }
+      return;
+   }
+
+   check(is_account(contract), error_code::ACCOUNT_NOT_FOUND);
+   check(min_rate >= 0 && max_rate > min_rate, error_code::FEED_BOUNDS_INVALID);
+
+   /** Create or update feed settings **/
+   auto set_feed = [&](auto& row) {
+      row.symbol = collateral_iterator->symbol;
+      row.contract = contract;
+      row.pair = pair;
+      row.precision = precision;
+      row.max_age = max_age;
+      row.min_rate = min_rate;
+      row.max_rate = max_rate;
+   };
+   if (feed_iterator == feed_table.end()) {
+      feed_table.emplace(get_self(), set_feed);
+   } else {
+      feed_table.modify(feed_iterator, get_self(), set_feed);
+   }
+
+   /** Oracle rates are not used anymore, free their RAM **/
+   rate_index rate_table(get_self(), collateral.code().raw());
+   for (auto itr = rate_table.begin(); itr != rate_table.end();) {
+      STATS_ROWS(1);
+      itr = rate_table.erase(itr);
+   }
 }
 
 void zigzag::setinterest(name user, symbol collateral, double interest) {
+   STATS_BEGIN(name("setinterest"), collateral.code().raw());
+
    /** Check authorization **/
    auto system_user = get_param_string(MANAGER);
-   check(has_auth(name(system_user)) || has_auth(name(get_self())), "Unauthorized");
+   check(has_auth(name(system_user)) || has_auth(name(get_self())), error_code::UNAUTHORIZED);
 
    /** Check if collateral with this symbol exists **/
    collateral_index collateral_table(get_self(), get_self().value);
    auto collateral_iterator = collateral_table.find(collateral.code().raw());
-   check(collateral_iterator != collateral_table.end(), "Collateral does not exist");
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
 
    /** Check if user position exists **/
    position_index position_table(get_self(), collateral.code().raw());
    auto position_iterator = position_table.find(user.value);
-   check(position_iterator != position_table.end(), "User position does not exist");
+   check(position_iterator != position_table.end(), error_code::USER_POSITION_NOT_FOUND);
 
    /** Check interest range **/
-   check(interest >= 0, "Interest too low");
-   check(interest <= 100, "Interest too high");
+   check(interest >= 0, error_code::INTEREST_TOO_LOW);
+   check(interest <= 100, error_code::INTEREST_TOO_HIGH);
 
    /** Set interest **/
    position_table.modify(position_iterator, get_self(), [&](auto& row) {
@@ -262,48 +365,39 @@ asset zigzag::calcinterest(name user, symbol collateral, bool is_notify) {
    /** Check if collateral with this symbol exists **/
    collateral_index collateral_table(get_self(), get_self().value);
    auto collateral_iterator = collateral_table.find(collateral.code().raw());
-   check(collateral_iterator != collateral_table.end(), "Collateral does not exist");
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
 
    /** Check if position for collateral with this symbol exists **/
    position_index position_table(get_self(), collateral.code().raw());
    auto position_iterator = position_table.find(user.value);
-   check(position_iterator != position_table.end(), "Position does not exist");
-
-   /** Update amount_interest if position found and next_interest less then now **/
-   if (position_iterator->next_interest <= current_time_point().sec_since_epoch()) {
-      auto interest_interval = get_param_int(INTEREST_INT);
-      asset amount_interest = asset(
-         position_iterator->amount_borrowed.amount * position_iterator->interest_rate,
-         position_iterator->amount_interest.symbol
-      );
-      position_table.modify(position_iterator, get_self(), [&](auto& row) {
-         row.amount_interest += amount_interest;
-         row.next_interest += interest_interval;
-      });
+   check(position_iterator != position_table.end(), error_code::POSITION_NOT_FOUND);
+
+   /** Update amount_interest if next_interest less then now, debt of a collateral in global settlement does not grow **/
+   position_item position = *position_iterator;
+   asset amount_interest = position.amount_interest;
+   auto interest_interval = collateral_iterator->settlement_rate.value_or() == 0 ? accrue_interest(position) : 0;
+   if (interest_interval == 0) {
+      STATS_EARLY_EXIT();
+      return asset();
+   }
 
-      /** Start delayed transaction **/
-      eosio::transaction out;
-      out.actions.emplace_back(permission_level{get_self(), name("active")}, get_self(), name("addinterest"), std::make_tuple(user, collateral));
-      out.delay_sec = interest_interval;
-      uint128_t sender_id = get_deferred_tx_id(user, collateral);
-      cancel_deferred(sender_id);
-      out.send(sender_id, get_self(), true);
-
-      /** Send notification to user **/
-      if (is_notify) {
-         send_loan_status_notification(
-            user,
-            position_iterator->amount_interest + position_iterator->amount_borrowed
-         );
-      }
+   position_table.modify(position_iterator, get_self(), [&](auto& row) {
+      row = position;
+   });
+   set_liquidation_order(collateral, position);
+   schedule_interest(user, collateral, interest_interval);
 
-      return amount_interest;
+   /** Send notification to user **/
+   if (is_notify) {
+      send_loan_status_notification(user, position.amount_interest + position.amount_borrowed);
    }
 
-   return asset();
+   return position.amount_interest - amount_interest;
 }
 
 void zigzag::addinterest(name user, symbol collateral) {
+   STATS_BEGIN(name("addinterest"), collateral.code().raw());
+
    /** Throw if signed by wrong account **/
    require_auth(get_self());
 
@@ -311,75 +405,311 @@ void zigzag::addinterest(name user, symbol collateral) {
 }
 
 void zigzag::liquidate(name user, symbol collateral) {
+   STATS_BEGIN(name("liquidate"), collateral.code().raw());
+
    /** Check authorization **/
    auto cron_user = get_param_string(CRON_ACCOUNT);
-   check(has_auth(name(cron_user)) || has_auth(name(get_self())), "Unauthorized");
+   check(has_auth(name(cron_user)) || has_auth(name(get_self())), error_code::UNAUTHORIZED);
 
    /** Check if collateral with this symbol exists **/
    collateral_index collateral_table(get_self(), get_self().value);
    auto collateral_iterator = collateral_table.find(collateral.code().raw());
-   check(collateral_iterator != collateral_table.end(), "Collateral does not exist");
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
    
    /** Check if user has opened position **/
    position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
    auto position_iterator = position_table.find(user.value);
-   check(position_iterator != position_table.end(), "User position does not exist");
+   check(position_iterator != position_table.end(), error_code::USER_POSITION_NOT_FOUND);
+
+   /** Positions of a collateral in global settlement are closed by settle at the fixed rate **/
+   check(collateral_iterator->settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
 
    double threshold = get_param_double(LIQUIDATE_THRESHOLD);
-   double penalty = get_param_double(PENALTY);
-   std::string liquidate_account = get_param_string(LIQUIDATE_ACCOUNT);
    double rate = get_average_rate(collateral);
 
    /** Check if real need to liquidate **/
-   asset amount_collateral_in_zig = convert_asset(position_iterator->amount_collateral, ZIG_SYMBOL, rate);
-   asset amount_loan = position_iterator->amount_interest + position_iterator->amount_borrowed;
-   double ratio = (double)amount_collateral_in_zig.amount / (double)amount_loan.amount;
-   print("Threshold " + std::to_string(threshold) + '\n');
-   print("Ratio " + std::to_string(ratio) + '\n');
-   if (ratio > threshold) {
+   if (!is_liquidation_due(*position_iterator, rate, threshold)) {
+      STATS_EARLY_EXIT();
       return;
    }
-   asset amount_to_liquidate = position_iterator->amount_collateral;
-   double amount_to_return = (double)amount_collateral_in_zig.amount * (1 - penalty) - (double)amount_loan.amount;
-   asset amount_collateral_to_return = asset(0, collateral);
+   erase_liquidation_order(collateral_iterator->symbol, user);
+   liquidate_position(position_table, position_iterator, *collateral_iterator, rate,
+      get_param_double(PENALTY), name(get_param_string(LIQUIDATE_ACCOUNT)));
+}
 
-   /** Return funds to user **/
-   print("Amount to return " + std::to_string(amount_to_return) + '\n');
-   if (amount_to_return > 0) {
-      amount_collateral_to_return = convert_asset(asset(amount_to_return, ZIG_SYMBOL), collateral, 1 / rate);
+void zigzag::startsettle(symbol collateral, double rate) {
+   STATS_BEGIN(name("startsettle"), collateral.code().raw());
+
+   /** Throw if signed by wrong account **/
+   require_auth(get_self());
+
+   /** Check if collateral with this symbol exists and is not settled yet **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+   check(collateral_iterator->settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
+   check(rate > 0, error_code::RATE_NOT_POSITIVE);
+
+   /** Settlement fields follow the id in the row **/
+   check(collateral_iterator->id.has_value(), error_code::MIGRATION_REQUIRED);
+
+   /** Freeze collateral and fix settlement rate **/
+   collateral_table.modify(collateral_iterator, get_self(), [&](auto& row) {
+      row.is_active = false;
+      row.settlement_rate = rate;
+   });
+}
+
+void zigzag::settle(symbol collateral, uint32_t limit) {
+   STATS_BEGIN(name("settle"), collateral.code().raw());
+
+   /** Check authorization **/
+   auto cron_user = get_param_string(CRON_ACCOUNT);
+   check(has_auth(name(cron_user)) || has_auth(name(get_self())), error_code::UNAUTHORIZED);
+
+   /** Check if collateral with this symbol exists and is in global settlement **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+   check(collateral_iterator->settlement_rate.value_or() != 0, error_code::COLLATERAL_NOT_SETTLING);
+
+   const double rate = collateral_iterator->settlement_rate.value_or();
+   const name token_account = collateral_iterator->account;
+   asset amount_to_liquidate = asset(0, collateral_iterator->symbol);
+
+   /** Settled positions are erased, so every batch closes the first limit positions left **/
+   position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
+   auto position_iterator = position_table.begin();
+   for (uint32_t count = 0; count < limit && position_iterator != position_table.end(); count++) {
+      STATS_ROWS(1);
+      const name user = position_iterator->account;
+
+      /** Return collateral exceeding the debt, no penalty is taken **/
+      asset amount_collateral_in_zig = convert_asset(position_iterator->amount_collateral, ZIG_SYMBOL, rate);
+      asset amount_loan = position_iterator->amount_interest + position_iterator->amount_borrowed;
+      asset amount_collateral_to_return = asset(0, position_iterator->amount_collateral.symbol);
+      if (amount_collateral_in_zig > amount_loan) {
+         amount_collateral_to_return = convert_asset(amount_collateral_in_zig - amount_loan, position_iterator->amount_collateral.symbol, 1 / rate);
+         if (amount_collateral_to_return > position_iterator->amount_collateral) {
+            amount_collateral_to_return = position_iterator->amount_collateral;
+         }
+      }
       if (amount_collateral_to_return.amount > 0) {
-         dispatch_inline(collateral_iterator->account, name("transfer"),
+         STATS_INLINE();
+         dispatch_inline(token_account, name("transfer"),
+            PERMISSION_LEVEL,
+            std::make_tuple(get_self(), user, amount_collateral_to_return, std::string("Position settled")));
+      } else {
+         send_notification(user, "Position settled");
+      }
+
+      /** Remaining collateral of the whole batch is sent with one transfer **/
+      amount_to_liquidate += position_iterator->amount_collateral - amount_collateral_to_return;
+
+      position_iterator = position_table.erase(position_iterator);
+      erase_liquidation_order(collateral_iterator->symbol, user);
+      cancel_deferred(get_deferred_tx_id(user, collateral_iterator->symbol));
+   }
+
+   if (amount_to_liquidate.amount > 0) {
+      std::string liquidate_account = get_param_string(LIQUIDATE_ACCOUNT);
+      STATS_INLINE();
+      dispatch_inline(token_account, name("transfer"),
          PERMISSION_LEVEL,
-         std::make_tuple(get_self(), user, amount_collateral_to_return, std::string("Position liquidated")));
+         std::make_tuple(get_self(), name(liquidate_account), amount_to_liquidate, std::string("Global settlement")));
+   }
+}
+
+void zigzag::rebalance(name user, symbol collateral, double target_ratio) {
+   STATS_BEGIN(name("rebalance"), collateral.code().raw());
+
+   /** Throw if signed by wrong account **/
+   require_auth(user);
+
+   /** Check if collateral with this symbol exists and is not settled **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+   check(collateral_iterator->settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
+
+   /** Check if user has opened position **/
+   position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
+   auto position_iterator = position_table.find(user.value);
+   check(position_iterator != position_table.end(), error_code::USER_POSITION_NOT_FOUND);
+
+   /** Position can not be leveraged above param(position.def) **/
+   double position_def = get_param_double(POSITION_DEF);
+   check(target_ratio == 0 || target_ratio >= position_def, error_code::RATIO_TOO_LOW, [&]() {
+      return std::to_string(position_def);
+   });
+
+   /** Add due interest first, so the ratio is taken against the whole debt, none in global settlement **/
+   position_item position = *position_iterator;
+   uint32_t interest_interval = collateral_iterator->settlement_rate.value_or() == 0 ? accrue_interest(position) : 0;
+
+   double rate = get_average_rate(collateral_iterator->symbol);
+   asset amount_loan = position.amount_borrowed + position.amount_interest;
+   asset amount_borrowed_change = asset(0, ZIG_SYMBOL);
+   asset amount_collateral_to_return = asset(0, position.amount_collateral.symbol);
+
+   if (target_ratio == 0) {
+      /** Borrow up to the loan limit, same as a loan with no new collateral **/
+      check(collateral_iterator->is_active, error_code::COLLATERAL_INACTIVE);
+      asset amount_loan_limit = get_loan_limit(position.amount_collateral, rate, position_def);
+      if (amount_loan_limit > amount_loan) {
+         amount_borrowed_change = amount_loan_limit - amount_loan;
+         position.amount_borrowed += amount_borrowed_change;
       }
    } else {
-      send_notification(user, "Position liquidated");
+      /** Release collateral the loan does not need at the target ratio **/
+      asset amount_collateral_required = get_required_collateral(amount_loan, position.amount_collateral, rate, target_ratio);
+      if (amount_collateral_required < position.amount_collateral) {
+         amount_collateral_to_return = position.amount_collateral - amount_collateral_required;
+         position.amount_collateral = amount_collateral_required;
+      }
    }
 
-   /** Liquidate remaining funds **/
-   if ((position_iterator->amount_collateral - amount_collateral_to_return).amount > 0) {
-      print("Amount to liquidate " + (position_iterator->amount_collateral - amount_collateral_to_return).to_string() + '\n');
-      dispatch_inline(collateral_iterator->account, name("transfer"),
+   if (interest_interval == 0 && amount_borrowed_change.amount == 0 && amount_collateral_to_return.amount == 0) {
+      STATS_EARLY_EXIT();
+      return;
+   }
+
+   /** Position without loan and collateral is closed, otherwise written back with a single update **/
+   bool is_closed = position.amount_collateral.amount == 0 && (position.amount_borrowed + position.amount_interest).amount == 0;
+   if (is_closed) {
+      position_table.erase(position_iterator);
+      erase_liquidation_order(collateral_iterator->symbol, user);
+      cancel_deferred(get_deferred_tx_id(user, collateral_iterator->symbol));
+   } else {
+      position_table.modify(position_iterator, get_self(), [&](auto& row) {
+         row = position;
+      });
+      set_liquidation_order(collateral_iterator->symbol, position);
+      if (interest_interval > 0) {
+         schedule_interest(user, collateral_iterator->symbol, interest_interval);
+      }
+   }
+
+   /** Send funds, at most one transfer **/
+   if (amount_borrowed_change.amount > 0) {
+      STATS_INLINE();
+      dispatch_inline(
+         ZIGZAG_NAME,
+         name("transfer"),
          PERMISSION_LEVEL,
-         std::make_tuple(get_self(), name(liquidate_account), position_iterator->amount_collateral - amount_collateral_to_return, std::string("")));
+         std::make_tuple(get_self(), user, amount_borrowed_change, get_loan_memo(position.amount_borrowed + position.amount_interest))
+      );
+   } else if (amount_collateral_to_return.amount > 0) {
+      STATS_INLINE();
+      dispatch_inline(
+         collateral_iterator->account,
+         name("transfer"),
+         PERMISSION_LEVEL,
+         std::make_tuple(get_self(), user, amount_collateral_to_return, std::string(is_closed ? "Position closed" : "Collateral released"))
+      );
    }
+}
 
-   /** Remove position **/
-   position_table.erase(position_iterator);
-   uint128_t sender_id = user.value;
-   sender_id = (sender_id << 64) | collateral.code().raw();
-   cancel_deferred(get_deferred_tx_id(user, collateral));
-   print("Position closed");
+void zigzag::reindex(symbol collateral, name from, uint32_t limit) {
+   STATS_BEGIN(name("reindex"), collateral.code().raw());
+
+   /** Check authorization **/
+   auto cron_user = get_param_string(CRON_ACCOUNT);
+   check(has_auth(name(cron_user)) || has_auth(name(get_self())), error_code::UNAUTHORIZED);
+
+   /** Check if collateral with this symbol exists **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   auto collateral_iterator = collateral_table.find(collateral.code().raw());
+   check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+
+   /** Positions are written back as they are, only their order rows change **/
+   position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
+   uint32_t count = 0;
+   auto itr = position_table.lower_bound(from.value);
+   for (; count < limit && itr != position_table.end(); itr++, count++) {
+      set_liquidation_order(collateral_iterator->symbol, *itr);
+   }
+
+   /** Order rows without a position in the walked accounts are dropped **/
+   order_index order_table(get_self(), collateral_iterator->symbol.code().raw());
+   bool is_last = itr == position_table.end();
+   for (auto order_iterator = order_table.lower_bound(from.value); order_iterator != order_table.end();) {
+      if (!is_last && order_iterator->account.value >= itr->account.value) {
+         break;
+      }
+      if (position_table.find(order_iterator->account.value) == position_table.end()) {
+         order_iterator = order_table.erase(order_iterator);
+         count++;
+      } else {
+         order_iterator++;
+      }
+   }
+   STATS_ROWS(count);
+}
+
+void zigzag::migrate() {
+   STATS_BEGIN(name("migrate"), get_self().value);
+
+   /** Throw if signed by wrong account **/
+   require_auth(get_self());
+
+   /** Collaterals without id get the lowest free one, extensions are filled in row order **/
+   collateral_index collateral_table(get_self(), get_self().value);
+   uint64_t used_ids = get_used_collateral_ids(collateral_table);
+   for (auto itr = collateral_table.begin(); itr != collateral_table.end(); itr++) {
+      STATS_ROWS(1);
+      if (itr->id.has_value() && itr->settlement_rate.has_value() && itr->check_rate.has_value()) {
+         continue;
+      }
+      collateral_table.modify(itr, get_self(), [&](auto& row) {
+         if (!row.id.has_value()) {
+            row.id = take_collateral_id(used_ids);
+         }
+         row.settlement_rate = row.settlement_rate.value_or();
+         row.check_rate = row.check_rate.value_or();
+      });
+   }
+
+   /** Legacy oracles are moved to the bitmask table, symbols of deleted collaterals are dropped **/
+   legacy_oracle_index legacy_oracle_table(get_self(), get_self().value);
+   oracle_index oracle_table(get_self(), get_self().value);
+   for (auto itr = legacy_oracle_table.begin(); itr != legacy_oracle_table.end();) {
+      STATS_ROWS(1);
+      uint64_t collaterals = 0;
+      for (auto& symbol : itr->symbols) {
+         auto collateral_iterator = collateral_table.find(symbol.code().raw());
+         if (collateral_iterator != collateral_table.end()) {
+            collaterals |= collateral_bit(*collateral_iterator->id);
+         }
+      }
+
+      /** Oracle added again after setcode keeps the symbols of both rows **/
+      auto oracle_iterator = oracle_table.find(itr->account.value);
+      if (oracle_iterator == oracle_table.end()) {
+         oracle_table.emplace(get_self(), [&](auto& row) {
+            row.account = itr->account;
+            row.collaterals = collaterals;
+         });
+      } else {
+         oracle_table.modify(oracle_iterator, get_self(), [&](auto& row) {
+            row.collaterals |= collaterals;
+         });
+      }
+      itr = legacy_oracle_table.erase(itr);
+   }
 }
 
 void zigzag::transferzig(name from, name to, asset quantity, std::string memo) {
+   STATS_BEGIN(name("transferzig"), get_self().value);
 
    /** Check for incoming transfer **/
    if (from == get_self() || to != get_self()) {
+      STATS_EARLY_EXIT();
       return;
    }
 
    if (from == ZIGZAG_NAME) {
+      STATS_EARLY_EXIT();
       return;
    }
 
@@ -388,150 +718,216 @@ void zigzag::transferzig(name from, name to, asset quantity, std::string memo) {
       memo = std::string(DEFAULT_COLLATERAL_SYMBOL);
    }
 
-   /** Check if collateral with this symbol exists **/
+   /** Memo is one collateral or a list of collaterals with optional amounts, "EOS:10.0000,BOS" **/
+   std::vector<repayment_allocation> allocations;
+   check(parse_repayment_memo(memo, allocations), error_code::MEMO_INVALID, [&]() {
+      return memo;
+   });
+
+   /** Listed amounts must fit in the transfer whatever the loans are **/
+   int64_t allocated = 0;
+   for (auto& allocation : allocations) {
+      allocated += allocation.amount;
+      check(allocated <= quantity.amount, error_code::ALLOCATION_EXCEEDED, [&]() {
+         return asset(allocated, quantity.symbol).to_string();
+      });
+   }
+
+   /** Repay positions in memo order, collateral of closed positions is sent after the change **/
    collateral_index collateral_table(get_self(), get_self().value);
-   auto collateral_iterator = collateral_table.find(symbol_code(memo).raw());
-   check(collateral_iterator != collateral_table.end(), "Collateral does not exist");
+   asset remaining = quantity;
+   asset amount_loan_left = asset(0, ZIG_SYMBOL);
+   bool is_partial = false;
+   std::vector<std::pair<name, asset>> collaterals_to_return;
+   for (auto& allocation : allocations) {
+
+      /** Check if collateral with this symbol exists **/
+      auto collateral_iterator = collateral_table.find(allocation.collateral.raw());
+      check(collateral_iterator != collateral_table.end(), error_code::COLLATERAL_NOT_FOUND);
+      if (&allocation == &allocations.front()) {
+         STATS_SCOPE(collateral_iterator->symbol.code().raw());
+      }
 
-   /** Check if user has opened position **/
-   position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
-   auto position_iterator = position_table.find(from.value);
-   check(position_iterator != position_table.end(), "User position does not exist");
+      /** Check if user has opened position **/
+      position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
+      auto position_iterator = position_table.find(from.value);
+      check(position_iterator != position_table.end(), error_code::USER_POSITION_NOT_FOUND);
 
-   asset loan = position_iterator->amount_borrowed + position_iterator->amount_interest;
+      asset loan = position_iterator->amount_borrowed + position_iterator->amount_interest;
 
-   /** Reject transfers below threshold if they are not closing **/
-   asset threshold = asset(1000, quantity.symbol);
-   check(quantity >= loan || quantity >= threshold,
-      "Transfer amount is below " + threshold.to_string() + " threshold");
-
-   /** If enought amount, close position **/
-   if (quantity >= loan) {
-
-      /** Send change **/
-      asset change = quantity - loan;
-      if (change.amount > 0) {
-         print("Send change to user " + change.to_string() + '\n');
-         dispatch_inline(
-            ZIGZAG_NAME,
-            name("transfer"),
-            PERMISSION_LEVEL,
-            std::make_tuple(get_self(), from, change, std::string(""))
-         );
+      /** Collateral without amount takes what is left of the transfer **/
+      asset amount = allocation.amount == 0 ? remaining : asset(allocation.amount, quantity.symbol);
+      check(amount <= remaining, error_code::ALLOCATION_EXCEEDED, [&]() {
+         return amount.to_string();
+      });
+      if (allocations.size() > 1 && amount.amount == 0) {
+         continue;
       }
 
-      /** Send collateral amount **/
-      print("Send collateral to user " + position_iterator->amount_collateral.to_string() + '\n');
+      /** Reject repayments below threshold if they are not closing **/
+      asset threshold = asset(1000, quantity.symbol);
+      check(amount >= loan || amount >= threshold, error_code::BELOW_THRESHOLD, [&]() {
+         return threshold.to_string();
+      });
+
+      /** If enought amount, close position **/
+      if (amount >= loan) {
+         remaining -= loan;
+         collaterals_to_return.emplace_back(collateral_iterator->account, position_iterator->amount_collateral);
+
+         /** Remove position **/
+         position_table.erase(position_iterator);
+         erase_liquidation_order(collateral_iterator->symbol, from);
+         cancel_deferred(get_deferred_tx_id(from, collateral_iterator->symbol));
+         debug_print("Position closed");
+
+      /** If not enought amount, update record **/
+      } else {
+         remaining -= amount;
+
+         /** Repay interest first, then borrowed amount, on a working copy of the position **/
+         position_item position = *position_iterator;
+         apply_repayment(position.amount_interest, position.amount_borrowed, amount.amount);
+         position_table.modify(position_iterator, get_self(), [&](auto& row) {
+            row = position;
+         });
+         set_liquidation_order(collateral_iterator->symbol, position);
+         amount_loan_left += position.amount_interest + position.amount_borrowed;
+         is_partial = true;
+      }
+   }
+
+   /** Send change of all repayments with one transfer **/
+   if (remaining.amount > 0) {
+      debug_print("Send change to user " + remaining.to_string() + '\n');
+      STATS_INLINE();
       dispatch_inline(
-         collateral_iterator->account,
+         ZIGZAG_NAME,
+         name("transfer"),
+         PERMISSION_LEVEL,
+         std::make_tuple(get_self(), from, remaining, std::string(""))
+      );
+   }
+
+   /** Send collateral of closed positions **/
+   for (auto& [token_account, amount_collateral] : collaterals_to_return) {
+      debug_print("Send collateral to user " + amount_collateral.to_string() + '\n');
+      STATS_INLINE();
+      dispatch_inline(
+         token_account,
          name("transfer"),
          PERMISSION_LEVEL,
          std::make_tuple(
             get_self(),
             from,
-            position_iterator->amount_collateral,
+            amount_collateral,
             std::string("Position closed")
          )
       );
+   }
 
-      /** Remove position **/
-      position_table.erase(position_iterator);
-      cancel_deferred(get_deferred_tx_id(from, collateral_iterator->symbol));
-      print("Position closed");
-
-   /** If not enought amount, update record and send notification **/
-   } else {
-      position_table.modify(position_iterator, get_self(), [&](auto& row) {
-         auto temp_amount_interest = row.amount_interest.amount;
-         row.amount_interest.amount -= row.amount_interest.amount > quantity.amount
-            ? quantity.amount
-            : row.amount_interest.amount;
-         if (row.amount_interest.amount == 0) {
-            auto remaining_amount = quantity.amount - temp_amount_interest;
-            row.amount_borrowed.amount -= row.amount_borrowed.amount > remaining_amount
-               ? remaining_amount
-               : row.amount_borrowed.amount;
-         }
-      });
-      send_loan_status_notification(
-         from,
-         position_iterator->amount_interest + position_iterator->amount_borrowed
-      );
+   /** One status notification with the debt left on partially repaid positions **/
+   if (is_partial) {
+      send_loan_status_notification(from, amount_loan_left);
    }
 }
 
 void zigzag::loan(name from, name to, asset quantity, std::string memo) {
+   /** Any token transfer comes here, counters go to the collateral scope only once it is known **/
+   STATS_BEGIN(name("loan"), get_self().value);
+
     /** Check for incoming transfer **/
    if (from == get_self() || to != get_self()) {
+      STATS_EARLY_EXIT();
       return;
    }
 
    /** Reject transfers below threshold **/
    asset threshold = asset(1000, quantity.symbol);
-   check(quantity >= threshold, "Transfer amount is below " + threshold.to_string() + " threshold");
+   check(quantity >= threshold, error_code::BELOW_THRESHOLD, [&]() {
+      return threshold.to_string();
+   });
 
    /** Check if collateral with this symbol exists **/
    collateral_index collateral(get_self(), get_self().value);
    auto collateral_iterator = collateral.find(quantity.symbol.code().raw());
-   if (collateral_iterator == collateral.end() || !collateral_iterator->is_active) {
+   check(collateral_iterator == collateral.end() || collateral_iterator->settlement_rate.value_or() == 0, error_code::COLLATERAL_SETTLING);
+   if (collateral_iterator == collateral.end()) {
+      STATS_EARLY_EXIT();
+      return;
+   }
+   STATS_SCOPE(collateral_iterator->symbol.code().raw());
+   if (!collateral_iterator->is_active) {
+      STATS_EARLY_EXIT();
       return;
    }
 
    /** Calculate average exchange rate **/
    double rate = zigzag::get_average_rate(quantity.symbol);
-   print("Got average rate " + std::to_string(rate) + '\n');
+   debug_print("Got average rate " + std::to_string(rate) + '\n');
 
    /** Get "position.def" and "interest.def" from params **/
    auto position_def = get_param_double(POSITION_DEF);
-   print("Got position_def " + std::to_string(position_def) + '\n');
+   debug_print("Got position_def " + std::to_string(position_def) + '\n');
 
    auto interest_def = get_param_double(INTEREST_DEF);
-   print("Got interest_def " + std::to_string(interest_def) + '\n');
+   debug_print("Got interest_def " + std::to_string(interest_def) + '\n');
    
-   /** Check if user has no opened position, create new empy position **/
+   /** Load user position into a working copy, or start a new empty one **/
    position_index position_table(get_self(), quantity.symbol.code().raw());
    auto position_iterator = position_table.find(from.value);
-   bool existing_position = false;
-   if (position_iterator == position_table.end()) {
-      position_iterator = position_table.emplace(get_self(), [&](auto& row) {
-         row.account = from;
-         row.amount_collateral = asset(0 ,quantity.symbol);
-         row.amount_borrowed = asset(0, ZIG_SYMBOL);
-         row.amount_interest = asset(0, ZIG_SYMBOL); 
-         row.interest_rate = interest_def;    
-         row.next_interest = current_time_point().sec_since_epoch();       
-      });
+   bool existing_position = position_iterator != position_table.end();
+   position_item position;
+   if (existing_position) {
+      position = *position_iterator;
    } else {
-      existing_position = true;
+      position.account = from;
+      position.amount_collateral = asset(0, quantity.symbol);
+      position.amount_borrowed = asset(0, ZIG_SYMBOL);
+      position.amount_interest = asset(0, ZIG_SYMBOL);
+      position.interest_rate = interest_def;
+      position.next_interest = current_time_point().sec_since_epoch();
    }
 
-   /** Get user position and update it with incoming data **/
-   asset amount_borrowed_change = asset(0, ZIG_SYMBOL);
-   asset to_return = asset(0, ZIG_SYMBOL);
-   position_table.modify(position_iterator, get_self(), [&](auto& row) {
-      row.amount_collateral += quantity;
-      asset collateral_value = convert_asset(row.amount_collateral,  ZIG_SYMBOL, rate);
-      collateral_value.set_amount(collateral_value.amount / position_def);
-      print("Collateral value ");
-      collateral_value.print();
-      print('\n');
-
-      amount_borrowed_change = collateral_value - (row.amount_borrowed + row.amount_interest);
-
-      /** If user amount_borrowed greater than previous value, update it **/
-      if (amount_borrowed_change.amount > 0) {
-         row.amount_borrowed += amount_borrowed_change;  
-      }
-      to_return = row.amount_borrowed + row.amount_interest;
-   });
+   /** Update position with incoming data **/
+   position.amount_collateral += quantity;
+   asset collateral_value = get_loan_limit(position.amount_collateral, rate, position_def);
+   debug_print("Collateral value ", collateral_value, '\n');
 
-   // For a new position add first interest without notification
+   asset amount_borrowed_change = collateral_value - (position.amount_borrowed + position.amount_interest);
+
+   /** If user amount_borrowed greater than previous value, update it **/
+   if (amount_borrowed_change.amount > 0) {
+      position.amount_borrowed += amount_borrowed_change;
+   }
+   asset to_return = position.amount_borrowed + position.amount_interest;
+
+   /** For a new position add first interest without notification **/
+   uint32_t interest_interval = 0;
    if (!existing_position) {
-      to_return += zigzag::calcinterest(from, quantity.symbol, false);
+      asset amount_interest = position.amount_interest;
+      interest_interval = accrue_interest(position);
+      to_return += position.amount_interest - amount_interest;
+   }
+
+   /** Write position back with a single table update **/
+   if (existing_position) {
+      position_table.modify(position_iterator, get_self(), [&](auto& row) {
+         row = position;
+      });
+   } else {
+      position_table.emplace(get_self(), [&](auto& row) {
+         row = position;
+      });
+   }
+   set_liquidation_order(quantity.symbol, position);
+   if (interest_interval > 0) {
+      schedule_interest(from, quantity.symbol, interest_interval);
    }
 
    /** Send funds if need **/
    if (amount_borrowed_change.amount > 0) {
+      STATS_INLINE();
       dispatch_inline(
          ZIGZAG_NAME,
          name("transfer"),
@@ -552,7 +948,7 @@ void zigzag::loan(name from, name to, asset quantity, std::string memo) {
  * ---------------
  */
 
-/** Calculate avarate exchange rate **/  
+/** Calculate avarate exchange rate, or read it from price feed if one is set for the collateral **/  
 double zigzag::get_average_rate(symbol collateral) {
    rate_index rate_table(get_self(), collateral.code().raw());
    double rate = 0;
@@ -562,17 +958,103 @@ double zigzag::get_average_rate(symbol collateral) {
       rate_count++;
       rate += itr->rate_to_usd;
    }
-   check(rate_count != 0, "Can not find exchange rate");   
+   STATS_ROWS(rate_count);
+
+   /** Collaterals with a price feed have no oracle rates (setfeed deletes them, setrate is rejected) **/
+   if (rate_count == 0) {
+      feed_index feed_table(get_self(), get_self().value);
+      auto feed_iterator = feed_table.find(collateral.code().raw());
+      check(feed_iterator != feed_table.end(), error_code::RATE_NOT_FOUND);
+      return get_feed_rate(*feed_iterator);
+   }
    rate /= rate_count;
    return rate;
 }
 
+/** Read median of the latest feed datapoint, throws if it is stale or out of bounds **/
+double zigzag::get_feed_rate(const feed_item& feed) {
+   datapoint_index datapoint_table(feed.contract, feed.pair.value);
+   check(datapoint_table.begin() != datapoint_table.end(), error_code::FEED_NOT_FOUND);
+   const auto& datapoint = *(--datapoint_table.end());
+
+   uint32_t now = current_time_point().sec_since_epoch();
+   uint32_t timestamp = datapoint.timestamp.sec_since_epoch();
+   check(timestamp >= now || now - timestamp <= feed.max_age, error_code::FEED_STALE, [&]() {
+      return std::to_string(now - timestamp) + " sec";
+   });
+
+   double rate = datapoint.median / pow(10, feed.precision);
+   check(rate >= feed.min_rate && rate <= feed.max_rate, error_code::FEED_OUT_OF_BOUNDS, [&]() {
+      return std::to_string(rate);
+   });
+   return rate;
+}
+
+/** Add due interest to the position working copy, returns interest interval or 0 if interest is not due yet **/
+uint32_t zigzag::accrue_interest(position_item& position) {
+   if (position.next_interest > current_time_point().sec_since_epoch()) {
+      return 0;
+   }
+   auto interest_interval = get_param_int(INTEREST_INT);
+   position.amount_interest += get_interest(position.amount_borrowed, position.interest_rate, position.amount_interest.symbol);
+   position.next_interest += interest_interval;
+   return interest_interval;
+}
+
+/** Replace scheduled interest calculation of the position **/
+void zigzag::schedule_interest(name user, symbol collateral, uint32_t interval) {
+   eosio::transaction out;
+   out.actions.emplace_back(permission_level{get_self(), name("active")}, get_self(), name("addinterest"), std::make_tuple(user, collateral));
+   out.delay_sec = interval;
+   STATS_INLINE();
+   uint128_t sender_id = get_deferred_tx_id(user, collateral);
+   cancel_deferred(sender_id);
+   out.send(sender_id, get_self(), true);
+}
+
+/** Build bitmask of collateral ids, throws if some symbol is not a collateral **/
+uint64_t zigzag::get_collaterals_mask(const std::vector<symbol>& symbols) {
+   collateral_index collateral(get_self(), get_self().value);
+   uint64_t mask = 0;
+   for (auto &symbol : symbols) {
+      auto symbol_iterator = collateral.find(symbol.code().raw());
+      check(symbol_iterator != collateral.end(), error_code::SYMBOL_NOT_FOUND);
+      check(symbol_iterator->id.has_value(), error_code::MIGRATION_REQUIRED);
+      mask |= collateral_bit(*symbol_iterator->id);
+   }
+   return mask;
+}
+
+/** Bitmask of ids taken by collaterals, collaterals not migrated yet have none **/
+uint64_t zigzag::get_used_collateral_ids(collateral_index& collateral_table) {
+   uint64_t used_ids = 0;
+   for (auto itr = collateral_table.begin(); itr != collateral_table.end(); itr++) {
+      STATS_ROWS(1);
+      if (itr->id.has_value()) {
+         used_ids |= collateral_bit(*itr->id);
+      }
+   }
+   return used_ids;
+}
+
+/** Lowest id not in used_ids, it is marked as used **/
+uint8_t zigzag::take_collateral_id(uint64_t& used_ids) {
+   uint8_t id = 0;
+   while (id < MAX_COLLATERALS && (used_ids & collateral_bit(id))) {
+      id++;
+   }
+   check(id < MAX_COLLATERALS, error_code::TOO_MANY_COLLATERALS);
+   used_ids |= collateral_bit(id);
+   return id;
+}
+
 /** Send loan status notification to user **/
 void zigzag::send_loan_status_notification(name user, asset amount) {
    send_notification(user, get_loan_memo(amount));
 }
 
 void zigzag::send_notification(name user, std::string notification) {
+   STATS_INLINE();
    dispatch_inline(
       ZIGZAG_NAME,
       name("transfer"),
@@ -581,6 +1063,179 @@ void zigzag::send_notification(name user, std::string notification) {
    );
 }
 
+#ifdef ZIGZAG_STATS
+/** Write counters of the executed action with a single row update **/
+void zigzag::flush_stats() {
+   if (_stats.action.value == 0) {
+      return;
+   }
+
+   stat_index stat_table(get_self(), _stats.scope);
+   auto iterator = stat_table.find(_stats.action.value);
+   if (iterator == stat_table.end()) {
+      stat_table.emplace(get_self(), [&](auto& row) {
+         row.action = _stats.action;
+         row.calls = 1;
+         row.early_exits = _stats.early_exits;
+         row.rows_scanned = _stats.rows_scanned;
+         row.inline_actions = _stats.inline_actions;
+      });
+   } else {
+      stat_table.modify(iterator, get_self(), [&](auto& row) {
+         row.calls++;
+         row.early_exits += _stats.early_exits;
+         row.rows_scanned += _stats.rows_scanned;
+         row.inline_actions += _stats.inline_actions;
+      });
+   }
+}
+#endif
+
+/** Collateral value to loan ratio of the position at the rate is not above param(liquidate.th) **/
+bool zigzag::is_liquidation_due(const position_item& position, double rate, double threshold) {
+   asset amount_collateral_in_zig = convert_asset(position.amount_collateral, ZIG_SYMBOL, rate);
+   double ratio = get_collateral_ratio(amount_collateral_in_zig, position.amount_interest + position.amount_borrowed);
+   debug_print("Threshold " + std::to_string(threshold) + '\n');
+   debug_print("Ratio " + std::to_string(ratio) + '\n');
+   return ratio <= threshold;
+}
+
+/** Close position due for liquidation, collateral above the loan and penalty goes back to the user, the rest to liquidate_account **/
+void zigzag::liquidate_position(position_index& position_table, position_index::const_iterator position_iterator, const collateral_item& collateral, double rate, double penalty, name liquidate_account) {
+   name user = position_iterator->account;
+   asset amount_collateral_in_zig = convert_asset(position_iterator->amount_collateral, ZIG_SYMBOL, rate);
+   asset amount_loan = position_iterator->amount_interest + position_iterator->amount_borrowed;
+   double amount_to_return = (double)amount_collateral_in_zig.amount * (1 - penalty) - (double)amount_loan.amount;
+   asset amount_collateral_to_return = asset(0, collateral.symbol);
+
+   /** Return funds to user **/
+   debug_print("Amount to return " + std::to_string(amount_to_return) + '\n');
+   if (amount_to_return > 0) {
+      amount_collateral_to_return = convert_asset(asset(amount_to_return, ZIG_SYMBOL), collateral.symbol, 1 / rate);
+      if (amount_collateral_to_return.amount > 0) {
+         STATS_INLINE();
+         dispatch_inline(collateral.account, name("transfer"),
+         PERMISSION_LEVEL,
+         std::make_tuple(get_self(), user, amount_collateral_to_return, std::string("Position liquidated")));
+      }
+   } else {
+      send_notification(user, "Position liquidated");
+   }
+
+   /** Liquidate remaining funds **/
+   if ((position_iterator->amount_collateral - amount_collateral_to_return).amount > 0) {
+      debug_print("Amount to liquidate " + (position_iterator->amount_collateral - amount_collateral_to_return).to_string() + '\n');
+      STATS_INLINE();
+      dispatch_inline(collateral.account, name("transfer"),
+         PERMISSION_LEVEL,
+         std::make_tuple(get_self(), liquidate_account, position_iterator->amount_collateral - amount_collateral_to_return, std::string("")));
+   }
+
+   /** Remove position **/
+   position_table.erase(position_iterator);
+   cancel_deferred(get_deferred_tx_id(user, collateral.symbol));
+   debug_print("Position closed");
+}
+
+/**
+ * Liquidate positions due for liquidation right after a rate update, when param(liquid.step) and
+ * param(liquid.limit) are set and the average rate moved by the step since the last check
+ * At most liquid.limit positions are closed, lowest ratio first, so the cost of setrate stays bounded
+ **/
+void zigzag::check_liquidations(collateral_index& collateral_table, collateral_index::const_iterator collateral_iterator) {
+   if (!is_liquidation_mode_on()) {
+      return;
+   }
+   double step = get_liquidation_step();
+   int limit = get_liquidation_limit();
+
+   double rate = get_average_rate(collateral_iterator->symbol);
+   double check_rate = collateral_iterator->check_rate.value_or();
+   if (check_rate > 0 && fabs(rate - check_rate) < check_rate * step) {
+      return;
+   }
+   collateral_table.modify(collateral_iterator, get_self(), [&](auto& row) {
+      /** Extensions are written in order, setrate accepts only collaterals with ids, missing settlement rate is filled for check_rate to follow **/
+      row.settlement_rate = row.settlement_rate.value_or();
+      row.check_rate = rate;
+   });
+
+   double threshold = get_param_double(LIQUIDATE_THRESHOLD);
+   double penalty = get_param_double(PENALTY);
+   name liquidate_account = name(get_param_string(LIQUIDATE_ACCOUNT));
+
+   /** All positions share the rate, once the lowest ratio is healthy the rest are too **/
+   position_index position_table(get_self(), collateral_iterator->symbol.code().raw());
+   order_index order_table(get_self(), collateral_iterator->symbol.code().raw());
+   auto ratio_index = order_table.get_index<name("byratio")>();
+   int count = 0;
+   while (count < limit) {
+      auto ratio_iterator = ratio_index.begin();
+      if (ratio_iterator == ratio_index.end()) {
+         break;
+      }
+      auto order_iterator = order_table.iterator_to(*ratio_iterator);
+      auto position_iterator = position_table.find(ratio_iterator->account.value);
+
+      /** Order row of a position closed while orders were not kept is dropped, it does not count to the limit **/
+      if (position_iterator == position_table.end()) {
+         order_table.erase(order_iterator);
+         STATS_ROWS(1);
+         continue;
+      }
+      if (!is_liquidation_due(*position_iterator, rate, threshold)) {
+         break;
+      }
+      order_table.erase(order_iterator);
+      liquidate_position(position_table, position_iterator, *collateral_iterator, rate, penalty, liquidate_account);
+      count++;
+   }
+   STATS_ROWS(count);
+}
+
+/** Liquidations on setrate need both params, without them order rows are not kept **/
+bool zigzag::is_liquidation_mode_on() {
+   if (!_liquidation_mode) {
+      _liquidation_mode = get_liquidation_step() > 0 && get_liquidation_limit() > 0;
+   }
+   return *_liquidation_mode;
+}
+
+/**
+ * Write liquidation order row of the position, position without one gets it here
+ * Only while liquidations on setrate are on, rows written before are brought up to date by reindex
+ **/
+void zigzag::set_liquidation_order(symbol collateral, const position_item& position) {
+   if (!is_liquidation_mode_on()) {
+      return;
+   }
+   order_index order_table(get_self(), collateral.code().raw());
+   double ratio = get_liquidation_order(position.amount_collateral, position.amount_borrowed + position.amount_interest);
+   auto order_iterator = order_table.find(position.account.value);
+   if (order_iterator == order_table.end()) {
+      order_table.emplace(get_self(), [&](auto& row) {
+         row.account = position.account;
+         row.ratio = ratio;
+      });
+   } else if (order_iterator->ratio != ratio) {
+      order_table.modify(order_iterator, get_self(), [&](auto& row) {
+         row.ratio = ratio;
+      });
+   }
+}
+
+/** Remove liquidation order row of a closed position, if it has one, rows left while the mode is off are dropped by reindex **/
+void zigzag::erase_liquidation_order(symbol collateral, name user) {
+   if (!is_liquidation_mode_on()) {
+      return;
+   }
+   order_index order_table(get_self(), collateral.code().raw());
+   auto order_iterator = order_table.find(user.value);
+   if (order_iterator != order_table.end()) {
+      order_table.erase(order_iterator);
+   }
+}
+
 uint128_t zigzag::get_deferred_tx_id(name user, symbol collateral) {
    uint128_t sender_id = user.value;
    sender_id = (sender_id << 64) | collateral.code().raw();
@@ -590,15 +1245,9 @@ uint128_t zigzag::get_deferred_tx_id(name user, symbol collateral) {
 
 extern "C" {
    void apply(uint64_t receiver, uint64_t code, uint64_t action) {
-      print("Receiver ");
-      print(name(receiver).to_string());
-      print("\n");
-      print("Code ");
-      print(name(code).to_string());
-      print("\n");
-      print("Action ");
-      print(name(action).to_string());
-      print("\n");
+      debug_print("Receiver ", name(receiver), '\n');
+      debug_print("Code ", name(code), '\n');
+      debug_print("Action ", name(action), '\n');
    
       if (action == name("transfer").value) {
          if (code == ZIGZAG_NAME.value) {
@@ -608,7 +1257,7 @@ extern "C" {
          }
       } else if (code == receiver) {
          switch (action) {
-            EOSIO_DISPATCH_HELPER(zigzag, (setparam)(addcollater)(setcollater)(delcollater)(addoracle)(setoracle)(deloracle)(setrate)(setinterest)(addinterest)(liquidate))
+            EOSIO_DISPATCH_HELPER(zigzag, (setparam)(addcollater)(setcollater)(delcollater)(addoracle)(setoracle)(deloracle)(setrate)(setfeed)(setinterest)(addinterest)(liquidate)(startsettle)(settle)(rebalance)(reindex)(migrate))
          }
       }
    }
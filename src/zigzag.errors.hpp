@@ -0,0 +1,84 @@
+#pragma once
+
+#include <eosio/check.hpp>
+#include <string>
+
+/**
+ * Contract error codes
+ *
+ * Every failed check aborts with "ZZ<code>: <message>". Codes are stable and are the
+ * client facing contract, messages are only a human readable hint. The full list is
+ * mirrored in README.md and test/constants.ts, test/native/errors.cpp checks the copies
+ *
+ * 1xx  Authorization and generic failures
+ * 2xx  Parameters and collaterals
+ * 3xx  Oracles and rates
+ * 4xx  Positions and transfers
+ **/
+#define ZIGZAG_ERRORS(X)                                                          \
+   X(101, UNAUTHORIZED,            "Unauthorized")                                \
+   X(102, ACCOUNT_NOT_FOUND,       "Account does not exist")                      \
+   X(103, MIGRATION_REQUIRED,      "Tables are not migrated, run migrate")        \
+   X(201, PARAM_NOT_FOUND,         "Param not found")                             \
+   X(202, TOKEN_NOT_FOUND,         "Token with symbol does not exist")            \
+   X(203, COLLATERAL_EXISTS,       "Collateral already added")                    \
+   X(204, COLLATERAL_NOT_FOUND,    "Collateral does not exist")                   \
+   X(205, COLLATERAL_ACTIVE,       "Collateral is active")                        \
+   X(206, TOO_MANY_COLLATERALS,    "Too many collaterals")                        \
+   X(207, COLLATERAL_SETTLING,     "Collateral is in global settlement")          \
+   X(208, COLLATERAL_NOT_SETTLING, "Collateral is not in global settlement")      \
+   X(209, COLLATERAL_INACTIVE,     "Collateral is not active")                    \
+   X(301, ORACLE_EXISTS,           "Oracle already added")                        \
+   X(302, ORACLE_NOT_FOUND,        "Oracle does not exist")                       \
+   X(303, SYMBOL_NOT_FOUND,        "Symbol does not exist")                       \
+   X(304, TOO_MANY_ORACLES,        "Too many oracles")                            \
+   X(305, SYMBOL_NOT_SUPPORTED,    "Symbol is not supported by this oracle")      \
+   X(306, RATE_NOT_POSITIVE,       "Rate must be greater than zero")              \
+   X(307, RATE_NOT_FOUND,          "Can not find exchange rate")                  \
+   X(308, FEED_MODE,               "Collateral rate is read from price feed")     \
+   X(309, FEED_NOT_FOUND,          "Price feed has no data")                      \
+   X(310, FEED_STALE,              "Price feed is stale")                         \
+   X(311, FEED_OUT_OF_BOUNDS,      "Price feed rate is out of bounds")            \
+   X(312, FEED_BOUNDS_INVALID,     "Price feed bounds are invalid")               \
+   X(401, POSITION_NOT_FOUND,      "Position does not exist")                     \
+   X(402, USER_POSITION_NOT_FOUND, "User position does not exist")                \
+   X(403, INTEREST_TOO_LOW,        "Interest too low")                            \
+   X(404, INTEREST_TOO_HIGH,       "Interest too high")                           \
+   X(405, BELOW_THRESHOLD,         "Transfer amount is below threshold")          \
+   X(406, RATIO_TOO_LOW,           "Target ratio is below position.def")          \
+   X(407, MEMO_INVALID,            "Invalid repayment memo")                      \
+   X(408, ALLOCATION_EXCEEDED,     "Repayments exceed transfer amount")
+
+enum class error_code : uint16_t {
+#define ZIGZAG_ERROR_ENUM(code, id, message) id = code,
+   ZIGZAG_ERRORS(ZIGZAG_ERROR_ENUM)
+#undef ZIGZAG_ERROR_ENUM
+};
+
+/** Full abort message for the code, built at compile time **/
+inline const char* error_message(error_code code) {
+   switch (code) {
+#define ZIGZAG_ERROR_MESSAGE(code, id, message) case error_code::id: return "ZZ" #code ": " message;
+      ZIGZAG_ERRORS(ZIGZAG_ERROR_MESSAGE)
+#undef ZIGZAG_ERROR_MESSAGE
+   }
+   return "ZZ000: Unknown error";
+}
+
+/** Abort with the code message **/
+inline void check(bool pred, error_code code) {
+   if (!pred) {
+      eosio::check(false, error_message(code));
+   }
+}
+
+/**
+ * Abort with the code message followed by a detail
+ * Detail is a callable and is evaluated only on the failure path, so passing checks do no formatting
+ **/
+template <typename Detail>
+inline void check(bool pred, error_code code, Detail&& detail) {
+   if (!pred) {
+      eosio::check(false, std::string(error_message(code)) + ": " + detail());
+   }
+}
@@ -1,31 +1,44 @@
 #include <eosio/eosio.hpp>
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
 #include <eosio/action.hpp>
 #include <eosio/system.hpp>
 #include <eosio/transaction.hpp>
 #include <cmath>
+#include <optional>
+
+#include "zigzag.common.hpp"
+#include "zigzag.errors.hpp"
 
 using namespace eosio;
 
-/* Maximum allowed number of oracles **/
-#define MAX_ORACLES name("max.oracles")
-#define POSITION_DEF name("position.def")
-#define INTEREST_DEF name("interest.def")
-#define INTEREST_INT name("interest.int")
-#define LIQUIDATE_THRESHOLD name("liquidate.th")
-#define PENALTY name("penalty")
-#define MANAGER name("manager")
-#define LIQUIDATE_ACCOUNT name("liquid.addr")
-#define CRON_ACCOUNT name("cron.account")
-
-#define ZIGZAG_NAME name("zigtokenhome")
-
-#define DEFAULT_COLLATERAL_SYMBOL "EOS"
-#define ZIG_SYMBOL symbol("ZIG", 4)
+#define MAX_COLLATERALS 64
 #define NOTIFICATION_AMOUNT asset(1, ZIG_SYMBOL)
 
 #define PERMISSION_LEVEL { permission_level(get_self(), name("active")) }
 
+/* Console output is compiled in only for debug builds (ZIGZAG_DEBUG), release builds do no formatting for it **/
+#ifdef ZIGZAG_DEBUG
+#define debug_print(...) print(__VA_ARGS__)
+#else
+#define debug_print(...)
+#endif
+
+/* Hot path counters are compiled in only for instrumented builds (ZIGZAG_STATS), see stat_item **/
+#ifdef ZIGZAG_STATS
+#define STATS_BEGIN(action, scope) _stats.begin(action, scope)
+#define STATS_SCOPE(value) _stats.scope = (value)
+#define STATS_EARLY_EXIT() _stats.early_exits++
+#define STATS_ROWS(count) _stats.rows_scanned += (count)
+#define STATS_INLINE() _stats.inline_actions++
+#else
+#define STATS_BEGIN(action, scope)
+#define STATS_SCOPE(scope)
+#define STATS_EARLY_EXIT()
+#define STATS_ROWS(count)
+#define STATS_INLINE()
+#endif
+
 class [[eosio::contract("zigzag")]] zigzag : public contract {
 
 public:
@@ -35,6 +48,17 @@ public:
 
    }
 
+#ifdef ZIGZAG_NATIVE
+   /** Native tests and benchmarks (test/native) reach private helpers and tables through it **/
+   friend struct zigzag_native;
+#endif
+
+#ifdef ZIGZAG_STATS
+   ~zigzag() {
+      flush_stats();
+   }
+#endif
+
    [[eosio::action]]
    /**
     * Change existing or create new parameter
@@ -75,6 +99,7 @@ public:
     * 
     * @throws When signed not by contract active key
     * @throws When such symbol does not exist in the table
+    * @throws When activating collateral in global settlement
     **/
    void setcollater(symbol symbol, bool is_active);
 
@@ -141,6 +166,9 @@ public:
    [[eosio::action]]
    /**
     * Updates or creates new rate for collateral by a particular oracle
+    * When param(liquid.step) and param(liquid.limit) are set and the average rate has moved by liquid.step
+    * (relative) since the last check, up to liquid.limit positions due for liquidation are liquidated,
+    * lowest collateral ratio first. Positions left over are liquidated by the cron account
     * 
     * @sign By one of the oracle active keys
     * 
@@ -153,9 +181,34 @@ public:
     * @throws When such collateral is not allowed for this oracle
     * @throws When rate is zero or negative
     * @throws When rate is differs by more than a constant perscentage from the median rate for this collateral (unless there were no rates for this oracle)
+    * @throws When collateral is in global settlement
+    * @throws When collateral rate is read from price feed
     **/
    void setrate(name oracle, symbol collateral, double rate);
 
+   [[eosio::action]]
+   /**
+    * Switches collateral rate source to a price feed contract, or back to oracle rates
+    * While feed is set the rate is the median of the latest datapoint of the feed pair, oracle rates
+    * of the collateral are deleted and setrate is rejected for it
+    * 
+    * @sign Contract active key
+    * 
+    * @param collateral Collateral to read rate from feed for
+    * @param contract   Feed contract account (datapoints table), empty name switches collateral back to oracle rates
+    * @param pair       Feed pair name (datapoints table scope)
+    * @param precision  Number of decimal places of feed values
+    * @param max_age    Maximum age of the latest datapoint in seconds
+    * @param min_rate   Lowest accepted feed rate
+    * @param max_rate   Highest accepted feed rate
+    * 
+    * @throws When signed not by contract active key
+    * @throws When collateral does not exist in our system
+    * @throws When feed contract account does not exist
+    * @throws When min_rate is negative or max_rate is not greater than min_rate
+    **/
+   void setfeed(symbol collateral, name contract, name pair, uint8_t precision, uint32_t max_age, double min_rate, double max_rate);
+
    [[eosio::action]]
    /**
     * Updates daily interest rate for a particular user's position
@@ -179,6 +232,7 @@ public:
     * Calculates interest for a particular user's position (called from cron processor)
     * Interest is added daily to the amount_interest according to the current user-collateral daily interest rate applied to amount_borrowed
     * Also next_interest interest value is update to +24h
+    * Positions of a collateral in global settlement get no interest and are not rescheduled
     * 
     * @sign By designated cron account (from settings)
     * 
@@ -213,10 +267,101 @@ public:
     * @throws When user does not exist in the system
     * @throws When collateral does not exist in our system
     * @throws When user-collateral pair does not exist in our system
+    * @throws When collateral is in global settlement
     * @throws When position is not due for liquidation
     **/
    void liquidate(name user, symbol collateral);
 
+   [[eosio::action]]
+   /**
+    * Puts collateral into global settlement mode
+    * Collateral is deactivated, loan and setrate are rejected for it and all its positions are closed by settle at the fixed rate
+    * No interest is added to its positions from then on
+    * 
+    * @sign Contract active key
+    * 
+    * @param collateral Collateral to settle
+    * @param rate       Fixed settlement exchange rate
+    * 
+    * @throws When signed not by contract active key
+    * @throws When collateral does not exist in our system
+    * @throws When collateral is already in global settlement
+    * @throws When rate is zero or negative
+    **/
+   void startsettle(symbol collateral, double rate);
+
+   [[eosio::action]]
+   /**
+    * Closes next batch of positions of the collateral in global settlement
+    * Positions are walked from the first one left, each one is closed at the settlement rate without penalty:
+    * collateral exceeding (amount_borrowed + amount_interest) is returned to the user, the rest of the batch
+    * is sent to param(liquid.addr) with a single transfer
+    * 
+    * @sign By designated cron account (from settings)
+    * 
+    * @param collateral Collateral in global settlement
+    * @param limit      Maximum number of positions to close
+    * 
+    * @throws When signed not by cron account
+    * @throws When collateral does not exist in our system
+    * @throws When collateral is not in global settlement
+    **/
+   void settle(symbol collateral, uint32_t limit);
+
+   [[eosio::action]]
+   /**
+    * Adjusts leverage of a position without new transfers
+    * Due interest is added first, then position moves to the target in one step:
+    * with target_ratio 0 more ZIG is sent to the user until (amount_borrowed + amount_interest) reaches the param(position.def) limit,
+    * otherwise collateral exceeding what the loan needs at target_ratio is returned to the user (position without loan is closed)
+    * 
+    * @sign By the user
+    * 
+    * @param user         User to rebalance position for
+    * @param collateral   Collateral of the position
+    * @param target_ratio Collateral value to loan ratio to release collateral down to, 0 to borrow up to param(position.def)
+    * 
+    * @throws When signed not by the user
+    * @throws When collateral does not exist in our system
+    * @throws When collateral is in global settlement
+    * @throws When user-collateral pair does not exist in our system
+    * @throws When target_ratio is not 0 and is below param(position.def)
+    * @throws When borrowing from collateral which is not active
+    **/
+   void rebalance(name user, symbol collateral, double target_ratio);
+
+   [[eosio::action]]
+   /**
+    * Adds liquidation order rows of positions opened before the liqorders table or while liquidations on setrate
+    * were off, setrate does not see positions without one. Order rows without a position are dropped
+    * Positions are walked in account order from the given account, rows which are already in place are kept
+    * With param(liquid.step) or param(liquid.limit) not set only the rows without a position are dropped
+    * 
+    * @sign By designated cron account (from settings)
+    * 
+    * @param collateral Collateral of the positions
+    * @param from       Account to start from, empty name for the first position
+    * @param limit      Maximum number of positions to walk
+    * 
+    * @throws When signed not by cron account
+    * @throws When collateral does not exist in our system
+    **/
+   void reindex(symbol collateral, name from, uint32_t limit);
+
+   [[eosio::action]]
+   /**
+    * One-time upgrade of tables written by contract versions before collateral ids
+    * Collaterals get the lowest free ids and their missing fields are filled (not settling, no liquidation check yet),
+    * legacy oracles rows are moved to oraclemasks with symbols converted to the ids bitmask (symbols of deleted collaterals are dropped)
+    * Does nothing on migrated tables
+    * 
+    * @sign Contract active key
+    * 
+    * @throws When signed not by contract active key
+    * @throws When there are more collaterals than ids
+    **/
+   void migrate();
+
    /**
     * Notify method on EOS transfer
     * Adds received EOS as collateral to existing position or creates a new one
@@ -225,10 +370,16 @@ public:
    void transfereos(name from, name to, asset quantity, std::string memo);
 
    /**
-    * Notify method on EOS transfer
-    * If there is an open position then amount_interest and amount_borrowed are deduced by the sent amount (interest first)
-    * If both amount_interest and amount_borrowed are 0 then position is closed and collateral EOS is sent back to the sender
-    * All remaining ZIG are sent back to the sender
+    * Notify method on ZIG transfer
+    * Memo selects positions to repay: one collateral symbol code (EOS by default), or a comma separated list of
+    * collaterals with optional ZIG amounts ("EOS:10.0000,BOS"), collateral without amount takes what is left of the transfer
+    * For every position amount_interest and amount_borrowed are deduced by its amount (interest first)
+    * If amount covers the whole loan then position is closed and its collateral is sent back to the sender
+    * All remaining ZIG are sent back with one transfer, one loan status notification covers all partially repaid positions
+    * 
+    * @throws When memo is malformed or repeats a collateral
+    * @throws When amounts in memo exceed the transfer
+    * @throws When a partial repayment is below threshold
     **/
    void transferzig(name from, name to, asset quantity, std::string memo);
 
@@ -239,6 +390,7 @@ public:
     * 
     * @throws When collateral does not exist in our system
     * @throws When enough ZIG balance to send
+    * @throws When collateral is in global settlement
     **/
    void loan(name from, name to, asset quantity, std::string memo);
 
@@ -262,9 +414,12 @@ private:
     * @scope      self 
     **/
    struct [[eosio::table]] collateral_item {
-      symbol symbol;                   // Collateral symbol
+      eosio::symbol symbol;            // Collateral symbol
       name account;                    // Collateral account name
       bool is_active;
+      eosio::binary_extension<uint8_t> id;               // Collateral bit index in oracle collaterals bitmask, unique among existing collaterals, missing until migrate
+      eosio::binary_extension<double> settlement_rate;   // Fixed rate of global settlement, missing or zero when collateral is not in global settlement
+      eosio::binary_extension<double> check_rate;        // Rate of the last liquidation check run by setrate, missing or zero before the first one
 
       uint64_t primary_key() const { return symbol.code().raw(); }   // IMPORTANT: Table is indexed by symbol code without precision
    };
@@ -277,11 +432,24 @@ private:
     **/
    struct [[eosio::table]] oracle_item {
       name account;                    // Oracle account
-      std::vector<symbol> symbols;     // List of symbols supported by this oracle
+      uint64_t collaterals;            // Bitmask of supported collaterals (bit N is set for collateral with id N)
 
       uint64_t primary_key() const { return account.value; }
    };
-   typedef eosio::multi_index<name("oracles"), oracle_item> oracle_index;
+   typedef eosio::multi_index<name("oraclemasks"), oracle_item> oracle_index;
+
+   /** 
+    * Oracles table of contract versions before collateral ids, rows are moved to oraclemasks by migrate
+    *
+    * @scope      self
+    **/
+   struct [[eosio::table]] legacy_oracle_item {
+      name account;                    // Oracle account
+      std::vector<eosio::symbol> symbols;   // List of symbols supported by this oracle
+
+      uint64_t primary_key() const { return account.value; }
+   };
+   typedef eosio::multi_index<name("oracles"), legacy_oracle_item> legacy_oracle_index;
 
    /** 
     * Table exchange rates for all collaterals from all oracles
@@ -296,6 +464,41 @@ private:
    };
    typedef eosio::multi_index<name("rates"), rate_item> rate_index;
 
+   /** 
+    * Table with price feed settings of collaterals which rate is read from a feed contract instead of oracle rates
+    * 
+    * @scope      self
+    **/
+   struct [[eosio::table]] feed_item {
+      eosio::symbol symbol;            // Collateral symbol
+      name contract;                   // Feed contract account
+      name pair;                       // Feed pair name, scope of the feed datapoints table
+      uint8_t precision;               // Number of decimal places of feed values
+      uint32_t max_age;                // Maximum age of the latest datapoint in seconds
+      double min_rate;                 // Lowest accepted feed rate
+      double max_rate;                 // Highest accepted feed rate
+
+      uint64_t primary_key() const { return symbol.code().raw(); }
+   };
+   typedef eosio::multi_index<name("feeds"), feed_item> feed_index;
+
+   /** 
+    * Datapoints table of the feed contract (delphioracle layout), only read by this contract
+    * Latest datapoint has the highest id
+    * 
+    * @scope      Feed pair name
+    **/
+   struct datapoint_item {
+      uint64_t id;
+      name owner;                      // Account which pushed the datapoint
+      uint64_t value;                  // Pushed value
+      uint64_t median;                 // Median of recent values at the time of the push
+      time_point timestamp;
+
+      uint64_t primary_key() const { return id; }
+   };
+   typedef eosio::multi_index<name("datapoints"), datapoint_item> datapoint_index;
+
    /** 
     * Table with all positions opened by our users 
     * 
@@ -315,41 +518,121 @@ private:
    };
    typedef eosio::multi_index<name("positions"), position_item> position_index;
 
+   /** 
+    * Liquidation order of positions for setrate, one row per position, written along with it
+    * Kept apart from positions, so positions written before the index stay as they are, reindex adds their rows
+    * 
+    * @scope      Collateral symbol code (without precision)
+    **/
+   struct [[eosio::table]] order_item {
+      name account;                    // User account of the position
+      double ratio;                    // Collateral to loan ratio of the position (get_liquidation_order)
+
+      uint64_t primary_key() const { return account.value; }
+      double by_ratio() const { return ratio; }
+   };
+   typedef eosio::multi_index<name("liqorders"), order_item,
+      eosio::indexed_by<name("byratio"), eosio::const_mem_fun<order_item, double, &order_item::by_ratio>>
+   > order_index;
+
+#ifdef ZIGZAG_STATS
+   /** 
+    * Hot path counters, present only in instrumented builds
+    * Counters collected during an action are written with a single row update when the action ends
+    * 
+    * @scope      Collateral symbol code (without precision), or self for actions not bound to a collateral
+    **/
+   struct [[eosio::table]] stat_item {
+      name action;                     // Action name
+      uint64_t calls;                  // Number of executed calls
+      uint64_t early_exits;            // Number of calls returned without doing any work
+      uint64_t rows_scanned;           // Number of table rows iterated over in loops
+      uint64_t inline_actions;         // Number of inline and deferred actions sent
+
+      uint64_t primary_key() const { return action.value; }
+   };
+   typedef eosio::multi_index<name("stats"), stat_item> stat_index;
+
+   /** Counters of the action being executed **/
+   struct stats_counter {
+      name action;
+      uint64_t scope = 0;
+      uint64_t early_exits = 0;
+      uint64_t rows_scanned = 0;
+      uint64_t inline_actions = 0;
+
+      /** Only the outermost action is recorded, nested logic (calcinterest from loan) adds to its counters **/
+      void begin(name action_name, uint64_t action_scope) {
+         if (action.value == 0) {
+            action = action_name;
+            scope = action_scope;
+         }
+      }
+   };
+   stats_counter _stats;
+
+   void flush_stats();
+#endif
+
+   /** Liquidations on setrate are on, read once per action by is_liquidation_mode_on **/
+   std::optional<bool> _liquidation_mode;
+
    double get_average_rate(symbol collateral);
+   double get_feed_rate(const feed_item& feed);
+   uint32_t accrue_interest(position_item& position);
+   void schedule_interest(name user, symbol collateral, uint32_t interval);
+   uint64_t get_collaterals_mask(const std::vector<symbol>& symbols);
+   uint64_t get_used_collateral_ids(collateral_index& collateral_table);
+   uint8_t take_collateral_id(uint64_t& used_ids);
    void send_loan_status_notification(name user, asset amount);
    void send_notification(name user, std::string notification);
+   bool is_liquidation_due(const position_item& position, double rate, double threshold);
+   void liquidate_position(position_index& position_table, position_index::const_iterator position_iterator, const collateral_item& collateral, double rate, double penalty, name liquidate_account);
+   void check_liquidations(collateral_index& collateral_table, collateral_index::const_iterator collateral_iterator);
+   bool is_liquidation_mode_on();
+   void set_liquidation_order(symbol collateral, const position_item& position);
+   void erase_liquidation_order(symbol collateral, name user);
    uint128_t get_deferred_tx_id(name user, symbol collateral);
 
    std::string get_param_string(name key) {
       param_index params(get_self(), get_self().value);
       auto iterator = params.find(key.value);
-      check(iterator != params.end(), key.to_string() + " param not found");
+      check(iterator != params.end(), error_code::PARAM_NOT_FOUND, [&]() {
+         return key.to_string();
+      });
       return iterator->value;
    }
 
+   /** Parameter of an optional mode, empty when it is not set **/
+   std::string get_optional_param_string(name key) {
+      param_index params(get_self(), get_self().value);
+      auto iterator = params.find(key.value);
+      return iterator != params.end() ? iterator->value : std::string();
+   }
+
    int get_param_int(name key) {
       auto value = get_param_string(key);
       return stoi(value);
    }
 
-   double _stod(std::string s)
-    {   
-        if (s == "") return 0;
-        std::size_t i = s.find(".");
-        int digits = s.length() - i - 1;
-        s.erase(i, 1); 
-        return atoi(s.c_str()) / pow(10, digits);
-    }  
-
    double get_param_double(name key) {
       auto value = get_param_string(key);
-      return _stod(value);
+      return param_to_double(value);
+   }
+
+   /** Step of liquidations on setrate, zero when param(liquid.step) is not set **/
+   double get_liquidation_step() {
+      return param_to_double(get_optional_param_string(LIQUIDATE_STEP));
+   }
+
+   /** Limit of liquidations on setrate, zero when param(liquid.limit) is not set **/
+   int get_liquidation_limit() {
+      auto value = get_optional_param_string(LIQUIDATE_LIMIT);
+      return value.empty() ? 0 : stoi(value);
    }
 
-   asset convert_asset(asset from, symbol to, double rate) {
-      double amount_from = from.amount / pow(10, from.symbol.precision());
-      double amount_to = amount_from * rate;
-      return asset(amount_to * pow(10, to.precision()), to);
+   uint64_t collateral_bit(uint8_t id) {
+      return 1ULL << id;
    }
 
    std::string get_loan_memo(asset amount) {
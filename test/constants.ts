@@ -37,7 +37,8 @@ export const ACTOR = {
   FAKE: new EosAccount('fake'),
   MANAGER: new EosAccount('actor.managr').key('5K9ssCJ9SHgk9ywNC2rNBDkXyYvYs96hSgH8tGttLsTuWFin2LN'),
   CRON: new EosAccount('actor.cron').key('5JREgHjXyy2wW3QhCGkTsunfa5PanQNY5SeD1erqCFcn4HKJ3oJ'),
-  LIQUIDATE: new EosAccount('liquid.addr').key('5JuXYKnMN8ae5NVWEX5CZJmxSt7qDXrN8ShGFwi9nP7V1T81jPc')
+  LIQUIDATE: new EosAccount('liquid.addr').key('5JuXYKnMN8ae5NVWEX5CZJmxSt7qDXrN8ShGFwi9nP7V1T81jPc'),
+  FEED: new EosAccount('price.feed').key('5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3')
 }
 
 export const SYMBOL: { [s: string]: EosCurrency } = {
@@ -58,13 +59,51 @@ export const PARAM = {
   PENALTY: 'penalty',
   MANAGER_ACCOUNT: 'manager',
   CRON_ACCOUNT: 'cron.account',
-  LIQUIDATE_ADDRESS: 'liquid.addr'
+  LIQUIDATE_ADDRESS: 'liquid.addr',
+  LIQUIDATE_STEP: 'liquid.step',
+  LIQUIDATE_LIMIT: 'liquid.limit'
 }
 
 export const TABLE = {
   PARAMS: 'params',
   COLLATERALS: 'collaterals',
-  ORACLES: 'oracles',
+  ORACLES: 'oraclemasks',
   RATES: 'rates',
-  POSITIONS: 'positions'
+  POSITIONS: 'positions',
+  FEEDS: 'feeds'
+}
+
+export const ERROR = {
+  UNAUTHORIZED: 'ZZ101: Unauthorized',
+  ACCOUNT_NOT_FOUND: 'ZZ102: Account does not exist',
+  MIGRATION_REQUIRED: 'ZZ103: Tables are not migrated, run migrate',
+  PARAM_NOT_FOUND: 'ZZ201: Param not found',
+  TOKEN_NOT_FOUND: 'ZZ202: Token with symbol does not exist',
+  COLLATERAL_EXISTS: 'ZZ203: Collateral already added',
+  COLLATERAL_NOT_FOUND: 'ZZ204: Collateral does not exist',
+  COLLATERAL_ACTIVE: 'ZZ205: Collateral is active',
+  TOO_MANY_COLLATERALS: 'ZZ206: Too many collaterals',
+  COLLATERAL_SETTLING: 'ZZ207: Collateral is in global settlement',
+  COLLATERAL_NOT_SETTLING: 'ZZ208: Collateral is not in global settlement',
+  COLLATERAL_INACTIVE: 'ZZ209: Collateral is not active',
+  ORACLE_EXISTS: 'ZZ301: Oracle already added',
+  ORACLE_NOT_FOUND: 'ZZ302: Oracle does not exist',
+  SYMBOL_NOT_FOUND: 'ZZ303: Symbol does not exist',
+  TOO_MANY_ORACLES: 'ZZ304: Too many oracles',
+  SYMBOL_NOT_SUPPORTED: 'ZZ305: Symbol is not supported by this oracle',
+  RATE_NOT_POSITIVE: 'ZZ306: Rate must be greater than zero',
+  RATE_NOT_FOUND: 'ZZ307: Can not find exchange rate',
+  FEED_MODE: 'ZZ308: Collateral rate is read from price feed',
+  FEED_NOT_FOUND: 'ZZ309: Price feed has no data',
+  FEED_STALE: 'ZZ310: Price feed is stale',
+  FEED_OUT_OF_BOUNDS: 'ZZ311: Price feed rate is out of bounds',
+  FEED_BOUNDS_INVALID: 'ZZ312: Price feed bounds are invalid',
+  POSITION_NOT_FOUND: 'ZZ401: Position does not exist',
+  USER_POSITION_NOT_FOUND: 'ZZ402: User position does not exist',
+  INTEREST_TOO_LOW: 'ZZ403: Interest too low',
+  INTEREST_TOO_HIGH: 'ZZ404: Interest too high',
+  BELOW_THRESHOLD: 'ZZ405: Transfer amount is below threshold',
+  RATIO_TOO_LOW: 'ZZ406: Target ratio is below position.def',
+  MEMO_INVALID: 'ZZ407: Invalid repayment memo',
+  ALLOCATION_EXCEEDED: 'ZZ408: Repayments exceed transfer amount'
 }
@@ -0,0 +1,63 @@
+#include <eosio/eosio.hpp>
+#include <eosio/system.hpp>
+
+using namespace eosio;
+
+/**
+ * Mock price feed contract used by tests
+ *
+ * Keeps datapoints table in the delphioracle layout, read by zigzag for collaterals set with setfeed.
+ * Anybody can write any value with any age, there is no median calculation
+ **/
+class [[eosio::contract("pricefeed")]] pricefeed : public contract {
+
+public:
+
+   using contract::contract;
+
+   [[eosio::action]]
+   /**
+    * Adds new latest datapoint for the pair
+    * 
+    * @param pair    Feed pair name (table scope)
+    * @param median  Datapoint value and median
+    * @param age     Datapoint age in seconds, timestamp is set to now - age
+    **/
+   void write(name pair, uint64_t median, uint32_t age) {
+      datapoint_index datapoints(get_self(), pair.value);
+      datapoints.emplace(get_self(), [&](auto& row) {
+         row.id = datapoints.available_primary_key();
+         row.owner = get_self();
+         row.value = median;
+         row.median = median;
+         row.timestamp = time_point(current_time_point().time_since_epoch() - seconds(age));
+      });
+   }
+
+   [[eosio::action]]
+   /**
+    * Deletes all datapoints of the pair
+    * 
+    * @param pair    Feed pair name (table scope)
+    **/
+   void clear(name pair) {
+      datapoint_index datapoints(get_self(), pair.value);
+      for (auto itr = datapoints.begin(); itr != datapoints.end();) {
+         itr = datapoints.erase(itr);
+      }
+   }
+
+private:
+   struct [[eosio::table]] datapoint_item {
+      uint64_t id;
+      name owner;
+      uint64_t value;
+      uint64_t median;
+      time_point timestamp;
+
+      uint64_t primary_key() const { return id; }
+   };
+   typedef eosio::multi_index<name("datapoints"), datapoint_item> datapoint_index;
+};
+
+EOSIO_DISPATCH(pricefeed, (write)(clear))
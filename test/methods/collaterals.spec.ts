@@ -56,6 +56,7 @@ describe('collaterals', () => {
       expect(result.symbol).toEqual(data.symbol);
       expect(result.account).toEqual(data.account);
       expect(result.is_active).toEqual(0);
+      expect(result.id).toEqual(1); // EOS collateral has id 0
     });
 
     it(`${ADD_COLLATERAL}: fail - collateral with this symbol already added`, async () => {
@@ -132,7 +133,25 @@ describe('collaterals', () => {
       const result = await getById(TABLE.COLLATERALS, SYMBOL.NEW.symbolName);
       expect(result).toBeUndefined();
 
-      // TODO: Add oracle with deleted symbol and check if the symbol is deleted from oraccle's list
+    });
+
+    it(`${DEL_COLLATERAL}: success - collateral removed from oracles`, async () => {
+      await expectSuccess(ADD_COLLATERAL, {
+        symbol: SYMBOL.NEW.toString(),
+        account: ACCOUNT_CURRENCY_NEW.name
+      }, ACTOR.CONTRACT);
+      await expectSuccess('setoracle', {
+        account: ACTOR.ORACLE_1.name,
+        symbols: [SYMBOL.EOS.toString(), SYMBOL.NEW.toString()]
+      }, ACTOR.CONTRACT);
+
+      const before = await getById(TABLE.ORACLES, ACTOR.ORACLE_1.nameValue);
+      expect(Number(before.collaterals)).toEqual(0b11);
+
+      await expectSuccess(DEL_COLLATERAL, data, ACTOR.CONTRACT);
+
+      const after = await getById(TABLE.ORACLES, ACTOR.ORACLE_1.nameValue);
+      expect(Number(after.collaterals)).toEqual(0b01);
     });
 
   });
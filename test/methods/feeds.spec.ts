@@ -0,0 +1,119 @@
+import { expectException, expectSuccess, transfer, getById, stringToName } from "../test.utils";
+import { ACTOR, SYMBOL, CONTRACT, TABLE, ERROR } from "../constants";
+import { setupNode } from "../setup";
+
+describe('feeds', () => {
+
+  jasmine.DEFAULT_TIMEOUT_INTERVAL = 600000;
+
+  const SET_FEED = 'setfeed';
+  const WRITE = 'write';
+  const CLEAR = 'clear';
+
+  const PAIR = 'eosusd';
+
+  const data = {
+    collateral: SYMBOL.EOS.toString(),
+    contract: ACTOR.FEED.name,
+    pair: PAIR,
+    precision: 4,
+    max_age: 600,
+    min_rate: 1.,
+    max_rate: 100.
+  };
+  const loan = {
+    from: ACTOR.ALICE.name,
+    to: ACTOR.CONTRACT.name,
+    quantity: '10.0000 EOS',
+    memo: ''
+  };
+
+  async function writeFeed(median: number, age: number = 0) {
+    await expectSuccess(WRITE, { pair: PAIR, median, age }, ACTOR.FEED, ACTOR.FEED.name);
+  }
+
+  beforeAll(async () => {
+    await setupNode();
+  });
+
+  describe(SET_FEED, () => {
+
+    it(`${SET_FEED}: fail - signed by invalid account`, async () => {
+      await expectException(SET_FEED, data, ACTOR.NOBODY);
+    });
+
+    it(`${SET_FEED}: fail - collateral not found`, async () => {
+      await expectException(SET_FEED, { ...data, collateral: SYMBOL.BOS.toString() }, ACTOR.CONTRACT, ERROR.COLLATERAL_NOT_FOUND);
+    });
+
+    it(`${SET_FEED}: fail - feed account does not exist`, async () => {
+      await expectException(SET_FEED, { ...data, contract: ACTOR.FAKE.name }, ACTOR.CONTRACT, ERROR.ACCOUNT_NOT_FOUND);
+    });
+
+    it(`${SET_FEED}: fail - invalid bounds`, async () => {
+      await expectException(SET_FEED, { ...data, min_rate: -1. }, ACTOR.CONTRACT, ERROR.FEED_BOUNDS_INVALID);
+      await expectException(SET_FEED, { ...data, max_rate: 1. }, ACTOR.CONTRACT, ERROR.FEED_BOUNDS_INVALID);
+    });
+
+    it(`${SET_FEED}: success - feed set and oracle rates deleted`, async () => {
+      expect(await getById(TABLE.RATES, stringToName(ACTOR.ORACLE_2.name), SYMBOL.EOS.symbolName)).toBeDefined();
+
+      await expectSuccess(SET_FEED, data, ACTOR.CONTRACT);
+
+      const result = await getById(TABLE.FEEDS, SYMBOL.EOS.symbolName);
+      expect(result).toBeDefined();
+      expect(result.contract).toEqual(ACTOR.FEED.name);
+      expect(result.pair).toEqual(PAIR);
+      expect(result.max_age).toEqual(600);
+      expect(await getById(TABLE.RATES, stringToName(ACTOR.ORACLE_2.name), SYMBOL.EOS.symbolName)).toBeUndefined();
+      expect(await getById(TABLE.RATES, stringToName(ACTOR.ORACLE_3.name), SYMBOL.EOS.symbolName)).toBeUndefined();
+    });
+
+    it(`${SET_FEED}: fail - setrate is rejected for feed collateral`, async () => {
+      await expectException('setrate', { oracle: ACTOR.ORACLE_1.name, collateral: SYMBOL.EOS.toString(), rate: 5. }, ACTOR.ORACLE_1, ERROR.FEED_MODE);
+    });
+  });
+
+  describe('loan', () => {
+
+    it(`loan: fail - feed has no data`, async () => {
+      await expectException('transfer', loan, ACTOR.ALICE, ERROR.FEED_NOT_FOUND, CONTRACT.EOS);
+    });
+
+    it(`loan: fail - feed is stale`, async () => {
+      // Detail is the datapoint age, which depends on block times
+      await writeFeed(60000, 3600);
+      await expectException('transfer', loan, ACTOR.ALICE, undefined, CONTRACT.EOS);
+      expect(await getById(TABLE.POSITIONS, stringToName(ACTOR.ALICE.name), SYMBOL.EOS.symbolName)).toBeUndefined();
+    });
+
+    it(`loan: fail - feed rate is out of bounds`, async () => {
+      await writeFeed(2000000);
+      await expectException('transfer', loan, ACTOR.ALICE, `${ERROR.FEED_OUT_OF_BOUNDS}: 200.000000`, CONTRACT.EOS);
+    });
+
+    it(`loan: success - position opened at feed rate`, async () => {
+      // 10.0000 EOS at 10 USD/EOS with position.def 1.5
+      await writeFeed(100000);
+      await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, loan.quantity);
+
+      const result = await getById(TABLE.POSITIONS, stringToName(ACTOR.ALICE.name), SYMBOL.EOS.symbolName);
+      expect(result).toBeDefined();
+      expect(result.amount_collateral).toEqual('10.0000 EOS');
+      expect(result.amount_borrowed).toEqual('66.6666 ZIG');
+    });
+  });
+
+  describe(`${SET_FEED} (remove)`, () => {
+
+    it(`${SET_FEED}: success - collateral switched back to oracle rates`, async () => {
+      await expectSuccess(SET_FEED, { ...data, contract: '' }, ACTOR.CONTRACT);
+      expect(await getById(TABLE.FEEDS, SYMBOL.EOS.symbolName)).toBeUndefined();
+
+      // Oracle rates were deleted with the feed switch, so there is no rate until oracles report again
+      await expectException('transfer', loan, ACTOR.ALICE, ERROR.RATE_NOT_FOUND, CONTRACT.EOS);
+      await expectSuccess('setrate', { oracle: ACTOR.ORACLE_1.name, collateral: SYMBOL.EOS.toString(), rate: 5. }, ACTOR.ORACLE_1);
+      await expectSuccess(CLEAR, { pair: PAIR }, ACTOR.FEED, ACTOR.FEED.name);
+    });
+  });
+});
@@ -1,7 +1,7 @@
 import Big from 'big.js';
 
 import { expectException, transfer, getAccountBalance, expectSuccess, getById, stringToName, DecimalString } from "../test.utils";
-import { ACTOR, SYMBOL, overrideParams, CONTRACT, TABLE, PARAM } from "../constants";
+import { ACTOR, SYMBOL, overrideParams, CONTRACT, TABLE, PARAM, ERROR } from "../constants";
 import { setupNode } from "../setup";
 
 describe('liquidate', () => {
@@ -34,17 +34,17 @@ describe('liquidate', () => {
       });
 
       it(`${LIQUIDATE}: fail - signed by wrong key`, async () => {
-        await expectException(LIQUIDATE, data, ACTOR.NOBODY, 'Unauthorized');
+        await expectException(LIQUIDATE, data, ACTOR.NOBODY, ERROR.UNAUTHORIZED);
       });
 
       it(`${LIQUIDATE}: fail - user not found`, async () => {
         const userNotFoundData = overrideParams(data, 'user', ACTOR.BOB.name);
-        await expectException(LIQUIDATE, userNotFoundData, ACTOR.CRON, 'User position does not exist');
+        await expectException(LIQUIDATE, userNotFoundData, ACTOR.CRON, ERROR.USER_POSITION_NOT_FOUND);
       });
 
       it(`${LIQUIDATE}: fail - collateral not found`, async () => {
         const collateralNotFoundData = overrideParams(data, 'collateral', SYMBOL.BOS.toString());
-        await expectException(LIQUIDATE, collateralNotFoundData, ACTOR.CRON, 'Collateral does not exist');
+        await expectException(LIQUIDATE, collateralNotFoundData, ACTOR.CRON, ERROR.COLLATERAL_NOT_FOUND);
       });
     })
 
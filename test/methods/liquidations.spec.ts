@@ -0,0 +1,63 @@
+import { expectSuccess, transfer, getAccountBalance, getById, stringToName, setRate } from "../test.utils";
+import { ACTOR, SYMBOL, CONTRACT, TABLE, PARAM } from "../constants";
+import { setupNode } from "../setup";
+
+describe('liquidations on setrate', () => {
+
+  jasmine.DEFAULT_TIMEOUT_INTERVAL = 600000;
+
+  beforeAll(async () => {
+    await setupNode();
+
+    // Alice has 11.0000 EOS for 44.0000 ZIG, Bob 25.0000 EOS for 100.1000 ZIG (lower ratio)
+    await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, '10.0000 EOS');
+    await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, '1.0000 EOS');
+    await transfer(CONTRACT.EOS, ACTOR.BOB, ACTOR.CONTRACT, '25.0000 EOS');
+
+    // Check on 10% rate moves, one position per setrate
+    await expectSuccess('setparam', { key: PARAM.LIQUIDATE_STEP, value: '0.1' }, ACTOR.CONTRACT);
+    await expectSuccess('setparam', { key: PARAM.LIQUIDATE_LIMIT, value: '1' }, ACTOR.CONTRACT);
+  });
+
+  const getPosition = (user: string) => getById(TABLE.POSITIONS, stringToName(user), SYMBOL.EOS.symbolName);
+
+  it(`setrate: success - first rate update is checked`, async () => {
+    // Average rate is 6 USD/EOS, both positions are healthy
+    await setRate(ACTOR.ORACLE_2, SYMBOL.EOS, 4);
+
+    expect(await getPosition(ACTOR.ALICE.name)).toBeDefined();
+    expect(await getPosition(ACTOR.BOB.name)).toBeDefined();
+  });
+
+  it(`setrate: success - move below step is not checked`, async () => {
+    // Average rate is 5.5 USD/EOS, 8.3% down, both positions are due but left for the keeper
+    await setRate(ACTOR.ORACLE_3, SYMBOL.EOS, 7);
+
+    expect(await getPosition(ACTOR.ALICE.name)).toBeDefined();
+    expect(await getPosition(ACTOR.BOB.name)).toBeDefined();
+  });
+
+  it(`setrate: success - worst position liquidated on move past step`, async () => {
+    const bobBefore = await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS');
+    const liquidateBefore = await getAccountBalance(CONTRACT.EOS, ACTOR.LIQUIDATE.name, 'EOS');
+
+    // Average rate is 5.3 USD/EOS, 11.7% down since the last check
+    await setRate(ACTOR.ORACLE_3, SYMBOL.EOS, 6.6);
+
+    // Limit is one position, Bob goes first
+    expect(await getPosition(ACTOR.BOB.name)).toBeUndefined();
+    expect(await getPosition(ACTOR.ALICE.name)).toBeDefined();
+
+    // 132.5000 ZIG of collateral less 15% penalty and 100.1000 ZIG of loan is 2.3632 EOS
+    const bobAfter = await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS');
+    expect(Number(bobAfter) - Number(bobBefore)).toBeCloseTo(2.3632, 3);
+    const liquidateAfter = await getAccountBalance(CONTRACT.EOS, ACTOR.LIQUIDATE.name, 'EOS');
+    expect(Number(liquidateAfter) - Number(liquidateBefore)).toBeCloseTo(22.6368, 3);
+  });
+
+  it(`liquidate: success - keeper closes the rest`, async () => {
+    await expectSuccess('liquidate', { user: ACTOR.ALICE.name, collateral: SYMBOL.EOS.toString() }, ACTOR.CRON);
+
+    expect(await getPosition(ACTOR.ALICE.name)).toBeUndefined();
+  });
+});
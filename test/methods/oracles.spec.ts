@@ -17,6 +17,10 @@ describe('oracles', () => {
   const ACCOUNT_CURRENCY_ORACLE_NEW: EosAccount = new EosAccount('neworaclecol').key('5JD6G7nvjNx36PPYpPmwbb6ybPHLNo3iB773sqxzifcypNsb72G');
   const CURRENCY_ORACLE_NEW: EosCurrency = new EosCurrency('ORTEST', 5).setAccount(ACCOUNT_CURRENCY_ORACLE_NEW).setSupply('1000000');
 
+  // EOS collateral is added first on node start and gets id 0, oracle test collateral gets id 1
+  const COLLATERAL_EOS_BIT = 1 << 0;
+  const COLLATERAL_ORACLE_NEW_BIT = 1 << 1;
+
   const ACCOUNT_ORACLE_1: EosAccount = new EosAccount('neworacle1').key('5HqXu4M1h7dJ7ehU7m4Xj7VXDNDTcrFdJPL1tWoTv8evmcj1J9R');
   const ACCOUNT_ORACLE_2: EosAccount = new EosAccount('neworacle2').key('5JQwcJKpMx35vLpakbfFxEMB8rdzutrAV32QaXqKckzGwu4iiYH');
 
@@ -70,7 +74,7 @@ describe('oracles', () => {
       const result = await getById(TABLE.ORACLES, ACCOUNT_ORACLE_NEW.nameValue);
       expect(result).toBeDefined();
       expect(result.account).toEqual(data.account);
-      expect(result.symbols).toEqual([CURRENCY_ORACLE_NEW.toString()]);
+      expect(Number(result.collaterals)).toEqual(COLLATERAL_ORACLE_NEW_BIT);
     });
 
     it(`${ADD_ORACLE}: fail - oracle with this account already added`, async () => {
@@ -122,13 +126,13 @@ describe('oracles', () => {
     it(`${SET_ORACLE}: success - oracle updated`, async () => {
       const before = await getById(TABLE.ORACLES, ACCOUNT_ORACLE_NEW.nameValue);
       expect(before).toBeDefined();
-      expect(before.symbols).toEqual([CURRENCY_ORACLE_NEW.toString()]);
+      expect(Number(before.collaterals)).toEqual(COLLATERAL_ORACLE_NEW_BIT);
 
       await expectSuccess(SET_ORACLE, data, ACTOR.CONTRACT);
 
       const result = await getById(TABLE.ORACLES, ACCOUNT_ORACLE_NEW.nameValue);
       expect(result).toBeDefined();
-      expect(result.symbols).toEqual([CURRENCY_ORACLE_NEW.toString(), SYMBOL.EOS.toString()]);
+      expect(Number(result.collaterals)).toEqual(COLLATERAL_ORACLE_NEW_BIT | COLLATERAL_EOS_BIT);
     });
 
   });
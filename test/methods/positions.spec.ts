@@ -1,5 +1,5 @@
 import { getAccountBalance, getById, DecimalString, stringToName, getUnixTime, setRate, expectException, expectSuccess, sleep, cleosGetActions, transfer } from "../test.utils";
-import { ACTOR, TABLE, SYMBOL, CONTRACT, overrideParams } from "../constants";
+import { ACTOR, TABLE, SYMBOL, CONTRACT, overrideParams, ERROR } from "../constants";
 import { setupNode } from "../setup";
 
 describe('positions', () => {
@@ -53,7 +53,7 @@ describe('positions', () => {
         to: ACTOR.CONTRACT.name,
         quantity: '0.0001 EOS',
         memo: ''
-      }, ACTOR.ALICE, 'Transfer amount is below 0.1000 EOS threshold', CONTRACT.EOS);
+      }, ACTOR.ALICE, `${ERROR.BELOW_THRESHOLD}: 0.1000 EOS`, CONTRACT.EOS);
 
       expect(await getAccountBalance(CONTRACT.EOS, ACTOR.ALICE.name, 'EOS')).toEqual('100');
       expect(await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG')).toEqual('0');
@@ -167,23 +167,23 @@ describe('positions', () => {
     const managerData = overrideParams(data, 'interest', 98.7000);
 
     it(`${SET_INTEREST}: fail - signed by invalid account`, async () => {
-      await expectException(SET_INTEREST, data, ACTOR.NOBODY, 'Unauthorized');
+      await expectException(SET_INTEREST, data, ACTOR.NOBODY, ERROR.UNAUTHORIZED);
     });
 
     it(`${SET_INTEREST}: fail - collateral does not exist in our system`, async () => {
-      await expectException(SET_INTEREST, collateralNotFound, ACTOR.CONTRACT, 'Collateral does not exist');
+      await expectException(SET_INTEREST, collateralNotFound, ACTOR.CONTRACT, ERROR.COLLATERAL_NOT_FOUND);
     });
 
     it(`${SET_INTEREST}: fail - user does not exist in our system`, async () => {
-      await expectException(SET_INTEREST, userNotFound, ACTOR.CONTRACT, 'User position does not exist');
+      await expectException(SET_INTEREST, userNotFound, ACTOR.CONTRACT, ERROR.USER_POSITION_NOT_FOUND);
     });
 
     it(`${SET_INTEREST}: fail - interest rate is less than zero`, async () => {
-      await expectException(SET_INTEREST, interestTooSmall, ACTOR.CONTRACT, 'Interest too low');
+      await expectException(SET_INTEREST, interestTooSmall, ACTOR.CONTRACT, ERROR.INTEREST_TOO_LOW);
     });
 
     it(`${SET_INTEREST}: fail - interest rate is more than 100`, async () => {
-      await expectException(SET_INTEREST, interestTooHihgt, ACTOR.CONTRACT, 'Interest too high');
+      await expectException(SET_INTEREST, interestTooHihgt, ACTOR.CONTRACT, ERROR.INTEREST_TOO_HIGH);
     });
 
     it(`${SET_INTEREST}: success - with system account`, async () => {
@@ -219,15 +219,15 @@ describe('positions', () => {
     const bobInvalidMemo = overrideParams(bobTransaction, 'memo', SYMBOL.BOS.name);
 
     it(`${REPAY_LOAN}: fail - default collateral position does not exist (no memo)`, async () => {
-      await expectException('transfer', bobNoMemo, ACTOR.BOB, 'User position does not exist', CONTRACT.ZIGZAG);
+      await expectException('transfer', bobNoMemo, ACTOR.BOB, ERROR.USER_POSITION_NOT_FOUND, CONTRACT.ZIGZAG);
     });
 
     it(`${REPAY_LOAN}: fail - collateral not found (invalid memo)`, async () => {
-      await expectException('transfer', bobInvalidMemo, ACTOR.BOB, 'Collateral does not exist', CONTRACT.ZIGZAG);
+      await expectException('transfer', bobInvalidMemo, ACTOR.BOB, ERROR.COLLATERAL_NOT_FOUND, CONTRACT.ZIGZAG);
     });
 
     it(`${REPAY_LOAN}: fail - user position not found`, async () => {
-      await expectException('transfer', bobTransaction, ACTOR.BOB, 'User position does not exist', CONTRACT.ZIGZAG);
+      await expectException('transfer', bobTransaction, ACTOR.BOB, ERROR.USER_POSITION_NOT_FOUND, CONTRACT.ZIGZAG);
       expect(await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS')).toEqual('100');
       expect(await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.BOB.name, 'ZIG')).toEqual('100');
     });
@@ -238,7 +238,7 @@ describe('positions', () => {
         to: ACTOR.CONTRACT.name,
         quantity: '0.0001 ZIG',
         memo: SYMBOL.EOS.name,
-      }, ACTOR.ALICE, 'Transfer amount is below 0.1000 ZIG threshold', CONTRACT.ZIGZAG);
+      }, ACTOR.ALICE, `${ERROR.BELOW_THRESHOLD}: 0.1000 ZIG`, CONTRACT.ZIGZAG);
       expect(await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS')).toEqual('100');
       expect(await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.BOB.name, 'ZIG')).toEqual('100');
     });
@@ -443,11 +443,11 @@ describe('positions', () => {
     });
 
     it(`${ADD_INTEREST}: fail - user not found`, async () => {
-        await expectException(ADD_INTEREST, userNotFoundData, ACTOR.CONTRACT, 'Position does not exist');
+        await expectException(ADD_INTEREST, userNotFoundData, ACTOR.CONTRACT, ERROR.POSITION_NOT_FOUND);
     });
 
     it(`${ADD_INTEREST}: fail - collateral not found`, async () => {
-        await expectException(ADD_INTEREST, collateralNotFoundData, ACTOR.CONTRACT, 'Collateral does not exist');
+        await expectException(ADD_INTEREST, collateralNotFoundData, ACTOR.CONTRACT, ERROR.COLLATERAL_NOT_FOUND);
     });
 
     it(`${ADD_INTEREST}: success - empty call`, async () => {
@@ -0,0 +1,91 @@
+import { expectException, expectSuccess, transfer, getAccountBalance, getById, stringToName, setRate } from "../test.utils";
+import { ACTOR, SYMBOL, CONTRACT, TABLE, ERROR } from "../constants";
+import { setupNode } from "../setup";
+
+describe('rebalance', () => {
+
+  jasmine.DEFAULT_TIMEOUT_INTERVAL = 600000;
+
+  const REBALANCE = 'rebalance';
+
+  beforeAll(async () => {
+    await setupNode();
+
+    // Open Alice position in EOS, 40.0000 ZIG borrowed and 0.0400 ZIG interest (average rate is 6 USD/EOS)
+    await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, '10.0000 EOS');
+  });
+
+  const data = { user: ACTOR.ALICE.name, collateral: SYMBOL.EOS.toString(), target_ratio: 0. };
+
+  const getPosition = () => getById(TABLE.POSITIONS, stringToName(ACTOR.ALICE.name), SYMBOL.EOS.symbolName);
+
+  it(`${REBALANCE}: fail - signed by another account`, async () => {
+    await expectException(REBALANCE, data, ACTOR.BOB);
+  });
+
+  it(`${REBALANCE}: fail - collateral not found`, async () => {
+    await expectException(REBALANCE, { ...data, collateral: SYMBOL.BOS.toString() }, ACTOR.ALICE, ERROR.COLLATERAL_NOT_FOUND);
+  });
+
+  it(`${REBALANCE}: fail - position not found`, async () => {
+    await expectException(REBALANCE, { ...data, user: ACTOR.BOB.name }, ACTOR.BOB, ERROR.USER_POSITION_NOT_FOUND);
+  });
+
+  it(`${REBALANCE}: fail - target ratio below position.def`, async () => {
+    await expectException(REBALANCE, { ...data, target_ratio: 1.2 }, ACTOR.ALICE, `${ERROR.RATIO_TOO_LOW}: 1.500000`);
+  });
+
+  it(`${REBALANCE}: success - nothing to borrow at position.def`, async () => {
+    await expectSuccess(REBALANCE, data, ACTOR.ALICE);
+
+    const position = await getPosition();
+    expect(position.amount_borrowed).toEqual('40.0000 ZIG');
+    expect(position.amount_collateral).toEqual('10.0000 EOS');
+  });
+
+  it(`${REBALANCE}: success - more ZIG borrowed after price rise`, async () => {
+    const before = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+
+    // Average rate is 9 USD/EOS, loan limit is 90 / 1.5 = 60.0000 ZIG
+    await setRate(ACTOR.ORACLE_2, SYMBOL.EOS, 10);
+    await expectSuccess(REBALANCE, data, ACTOR.ALICE);
+
+    const position = await getPosition();
+    expect(position.amount_borrowed).toEqual('59.9600 ZIG');
+    expect(position.amount_interest).toEqual('0.0400 ZIG');
+    expect(position.amount_collateral).toEqual('10.0000 EOS');
+
+    const after = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+    expect(Number(after) - Number(before)).toBeCloseTo(19.96, 4);
+  });
+
+  it(`${REBALANCE}: success - surplus collateral released`, async () => {
+    const before = await getAccountBalance(CONTRACT.EOS, ACTOR.ALICE.name, 'EOS');
+
+    // Average rate is 13 USD/EOS, loan of 60.0000 ZIG needs 60 * 2 / 13 = 9.2308 EOS at ratio 2
+    await setRate(ACTOR.ORACLE_3, SYMBOL.EOS, 16);
+    await expectSuccess(REBALANCE, { ...data, target_ratio: 2. }, ACTOR.ALICE);
+
+    const position = await getPosition();
+    expect(position.amount_borrowed).toEqual('59.9600 ZIG');
+    expect(position.amount_collateral).toEqual('9.2308 EOS');
+
+    const after = await getAccountBalance(CONTRACT.EOS, ACTOR.ALICE.name, 'EOS');
+    expect(Number(after) - Number(before)).toBeCloseTo(0.7692, 4);
+  });
+
+  it(`${REBALANCE}: success - nothing to release above target ratio`, async () => {
+    await expectSuccess(REBALANCE, { ...data, target_ratio: 3. }, ACTOR.ALICE);
+
+    const position = await getPosition();
+    expect(position.amount_collateral).toEqual('9.2308 EOS');
+  });
+
+  it(`${REBALANCE}: success - nothing to release at extreme target ratio`, async () => {
+    // Collateral required at the ratio does not fit in an asset amount, it is capped at the position collateral
+    await expectSuccess(REBALANCE, { ...data, target_ratio: 1e300 }, ACTOR.ALICE);
+
+    const position = await getPosition();
+    expect(position.amount_collateral).toEqual('9.2308 EOS');
+  });
+});
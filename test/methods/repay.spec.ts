@@ -0,0 +1,92 @@
+import { expectException, expectSuccess, transfer, getAccountBalance, getById, stringToName, setRate } from "../test.utils";
+import { ACTOR, SYMBOL, CONTRACT, TABLE, ERROR } from "../constants";
+import { setupNode } from "../setup";
+
+describe('repay', () => {
+
+  jasmine.DEFAULT_TIMEOUT_INTERVAL = 600000;
+
+  const REPAY = 'transfer';
+
+  beforeAll(async () => {
+    await setupNode();
+
+    // BOS collateral with rate 2 USD/BOS from oracle.1
+    await expectSuccess('addcollater', { symbol: SYMBOL.BOS.toString(), account: CONTRACT.BOS }, ACTOR.CONTRACT);
+    await expectSuccess('setcollater', { symbol: SYMBOL.BOS.toString(), is_active: 1 }, ACTOR.CONTRACT);
+    await expectSuccess('setoracle', { account: ACTOR.ORACLE_1.name, symbols: [SYMBOL.EOS.toString(), SYMBOL.BOS.toString()] }, ACTOR.CONTRACT);
+    await setRate(ACTOR.ORACLE_1, SYMBOL.BOS, 2);
+
+    // Alice borrows 40.0000 ZIG on EOS and 20.0000 ZIG on BOS, with 0.0400 and 0.0200 ZIG interest
+    await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, '10.0000 EOS');
+    await transfer(CONTRACT.BOS, ACTOR.ALICE, ACTOR.CONTRACT, '15.0000 BOS');
+  });
+
+  const repay = (quantity: string, memo: string) => ({
+    from: ACTOR.ALICE.name,
+    to: ACTOR.CONTRACT.name,
+    quantity,
+    memo,
+  });
+
+  const getPosition = (symbol: string) => getById(TABLE.POSITIONS, stringToName(ACTOR.ALICE.name), symbol);
+
+  it(`${REPAY}: fail - malformed memo`, async () => {
+    await expectException(REPAY, repay('10.0000 ZIG', 'EOS;BOS'), ACTOR.ALICE, `${ERROR.MEMO_INVALID}: EOS;BOS`, CONTRACT.ZIGZAG);
+    await expectException(REPAY, repay('10.0000 ZIG', 'EOS:1.00001'), ACTOR.ALICE, `${ERROR.MEMO_INVALID}: EOS:1.00001`, CONTRACT.ZIGZAG);
+  });
+
+  it(`${REPAY}: fail - collateral repeated`, async () => {
+    await expectException(REPAY, repay('10.0000 ZIG', 'EOS,EOS'), ACTOR.ALICE, `${ERROR.MEMO_INVALID}: EOS,EOS`, CONTRACT.ZIGZAG);
+  });
+
+  it(`${REPAY}: fail - amounts exceed transfer`, async () => {
+    await expectException(REPAY, repay('10.0000 ZIG', 'EOS:6.0000,BOS:6.0000'), ACTOR.ALICE, `${ERROR.ALLOCATION_EXCEEDED}: 12.0000 ZIG`, CONTRACT.ZIGZAG);
+  });
+
+  it(`${REPAY}: fail - amounts exceed transfer even if a loan takes less`, async () => {
+    // BOS loan is 20.0200 ZIG and would leave enough for EOS, listed amounts are checked before repaying
+    await expectException(REPAY, repay('28.0000 ZIG', 'BOS:25.0000,EOS:5.0000'), ACTOR.ALICE, `${ERROR.ALLOCATION_EXCEEDED}: 30.0000 ZIG`, CONTRACT.ZIGZAG);
+  });
+
+  it(`${REPAY}: success - two positions repaid with one status notification`, async () => {
+    const before = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+
+    await expectSuccess(REPAY, repay('15.0000 ZIG', 'EOS:10.0000,BOS:5.0000'), ACTOR.ALICE, CONTRACT.ZIGZAG);
+
+    // Interest is repaid first
+    const eos = await getPosition(SYMBOL.EOS.symbolName);
+    expect(eos.amount_interest).toEqual('0.0000 ZIG');
+    expect(eos.amount_borrowed).toEqual('30.0400 ZIG');
+    const bos = await getPosition(SYMBOL.BOS.symbolName);
+    expect(bos.amount_interest).toEqual('0.0000 ZIG');
+    expect(bos.amount_borrowed).toEqual('15.0200 ZIG');
+
+    // 15.0000 ZIG sent, 0.0001 ZIG notification received
+    const after = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+    expect(Number(before) - Number(after)).toBeCloseTo(14.9999, 4);
+  });
+
+  it(`${REPAY}: success - position closed, another repaid, change returned with one transfer`, async () => {
+    const zigBefore = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+    const bosBefore = await getAccountBalance(CONTRACT.BOS, ACTOR.ALICE.name, 'BOS');
+
+    await expectSuccess(REPAY, repay('20.0000 ZIG', 'BOS:16.0000,EOS:1.0000'), ACTOR.ALICE, CONTRACT.ZIGZAG);
+
+    expect(await getPosition(SYMBOL.BOS.symbolName)).toBeUndefined();
+    expect((await getPosition(SYMBOL.EOS.symbolName)).amount_borrowed).toEqual('29.0400 ZIG');
+
+    // BOS loan took 15.0200 ZIG, EOS 1.0000 ZIG, 3.9800 ZIG change and 0.0001 ZIG notification are returned
+    const zigAfter = await getAccountBalance(CONTRACT.ZIGZAG, ACTOR.ALICE.name, 'ZIG');
+    expect(Number(zigBefore) - Number(zigAfter)).toBeCloseTo(16.0199, 4);
+
+    const bosAfter = await getAccountBalance(CONTRACT.BOS, ACTOR.ALICE.name, 'BOS');
+    expect(Number(bosAfter) - Number(bosBefore)).toBeCloseTo(15, 4);
+  });
+
+  it(`${REPAY}: success - collateral without amount takes the rest`, async () => {
+    await expectSuccess(REPAY, repay('5.0000 ZIG', 'EOS'), ACTOR.ALICE, CONTRACT.ZIGZAG);
+
+    expect((await getPosition(SYMBOL.EOS.symbolName)).amount_borrowed).toEqual('24.0400 ZIG');
+  });
+});
@@ -0,0 +1,121 @@
+import { expectException, expectSuccess, transfer, getAccountBalance, getById, sleep, stringToName } from "../test.utils";
+import { ACTOR, SYMBOL, CONTRACT, TABLE, ERROR } from "../constants";
+import { setupNode } from "../setup";
+
+describe('settle', () => {
+
+  jasmine.DEFAULT_TIMEOUT_INTERVAL = 600000;
+
+  const START_SETTLE = 'startsettle';
+  const SETTLE = 'settle';
+
+  beforeAll(async () => {
+    await setupNode();
+
+    // Interest is added every second until the settlement starts
+    await expectSuccess('setparam', { key: 'interest.int', value: '1' }, ACTOR.CONTRACT);
+
+    // Open Alice and Bob positions in EOS, 40.0000 ZIG borrowed each (average rate is 6 USD/EOS)
+    await transfer(CONTRACT.EOS, ACTOR.ALICE, ACTOR.CONTRACT, '10.0000 EOS');
+    await transfer(CONTRACT.EOS, ACTOR.BOB, ACTOR.CONTRACT, '10.0000 EOS');
+  });
+
+  describe(START_SETTLE, () => {
+    const data = { collateral: SYMBOL.EOS.toString(), rate: 8. };
+
+    it(`${START_SETTLE}: fail - signed by invalid account`, async () => {
+      await expectException(START_SETTLE, data, ACTOR.NOBODY);
+    });
+
+    it(`${START_SETTLE}: fail - collateral not found`, async () => {
+      await expectException(START_SETTLE, { ...data, collateral: SYMBOL.BOS.toString() }, ACTOR.CONTRACT, ERROR.COLLATERAL_NOT_FOUND);
+    });
+
+    it(`${START_SETTLE}: fail - rate is not positive`, async () => {
+      await expectException(START_SETTLE, { ...data, rate: 0. }, ACTOR.CONTRACT, ERROR.RATE_NOT_POSITIVE);
+    });
+
+    it(`${SETTLE}: fail - collateral is not in global settlement`, async () => {
+      await expectException(SETTLE, { collateral: SYMBOL.EOS.toString(), limit: 10 }, ACTOR.CRON, ERROR.COLLATERAL_NOT_SETTLING);
+    });
+
+    it(`${START_SETTLE}: success - collateral frozen`, async () => {
+      await expectSuccess(START_SETTLE, data, ACTOR.CONTRACT);
+
+      const result = await getById(TABLE.COLLATERALS, SYMBOL.EOS.symbolName);
+      expect(result.is_active).toEqual(0);
+      expect(Number(result.settlement_rate)).toEqual(8);
+
+      await expectException(START_SETTLE, data, ACTOR.CONTRACT, ERROR.COLLATERAL_SETTLING);
+    });
+
+    it(`${START_SETTLE}: fail - loan, setrate and activation are rejected`, async () => {
+      await expectException('transfer', {
+        from: ACTOR.ALICE.name,
+        to: ACTOR.CONTRACT.name,
+        quantity: '1.0000 EOS',
+        memo: ''
+      }, ACTOR.ALICE, ERROR.COLLATERAL_SETTLING, CONTRACT.EOS);
+      await expectException('setrate', { oracle: ACTOR.ORACLE_1.name, collateral: SYMBOL.EOS.toString(), rate: 5. }, ACTOR.ORACLE_1, ERROR.COLLATERAL_SETTLING);
+      await expectException('setcollater', { symbol: SYMBOL.EOS.toString(), is_active: 1 }, ACTOR.CONTRACT, ERROR.COLLATERAL_SETTLING);
+    });
+
+    it(`${START_SETTLE}: fail - liquidation is rejected, positions are left for settle`, async () => {
+      await expectException('liquidate', { user: ACTOR.ALICE.name, collateral: SYMBOL.EOS.toString() }, ACTOR.CRON, ERROR.COLLATERAL_SETTLING);
+      expect(await getById(TABLE.POSITIONS, stringToName(ACTOR.ALICE.name), SYMBOL.EOS.symbolName)).toBeDefined();
+    });
+  });
+
+  describe(SETTLE, () => {
+    const getPosition = (actor) => getById(TABLE.POSITIONS, stringToName(actor.name), SYMBOL.EOS.symbolName);
+    const getLoan = (position) => Number.parseFloat(position.amount_borrowed) + Number.parseFloat(position.amount_interest);
+
+    it(`${SETTLE}: success - no interest is added during settlement`, async () => {
+      const position = await getPosition(ACTOR.ALICE);
+
+      // Scheduled interest is due every second, it stops once settlement started
+      await sleep(3000);
+      await expectSuccess('addinterest', { user: ACTOR.ALICE.name, collateral: SYMBOL.EOS.toString() }, ACTOR.CONTRACT);
+
+      const positionAfterSleep = await getPosition(ACTOR.ALICE);
+      expect(positionAfterSleep.amount_interest).toEqual(position.amount_interest);
+      expect(positionAfterSleep.next_interest).toEqual(position.next_interest);
+    });
+
+    it(`${SETTLE}: fail - signed by wrong key`, async () => {
+      await expectException(SETTLE, { collateral: SYMBOL.EOS.toString(), limit: 1 }, ACTOR.NOBODY, ERROR.UNAUTHORIZED);
+    });
+
+    it(`${SETTLE}: success - positions closed in batches`, async () => {
+      const aliceBefore = await getAccountBalance(CONTRACT.EOS, ACTOR.ALICE.name, 'EOS');
+      const bobBefore = await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS');
+      const liquidateBefore = await getAccountBalance(CONTRACT.EOS, ACTOR.LIQUIDATE.name, 'EOS');
+      const aliceLoan = getLoan(await getPosition(ACTOR.ALICE));
+      const bobLoan = getLoan(await getPosition(ACTOR.BOB));
+
+      // First batch closes Alice position, settled positions are erased so the next batch starts from Bob
+      await expectSuccess(SETTLE, { collateral: SYMBOL.EOS.toString(), limit: 1 }, ACTOR.CRON);
+      expect(await getPosition(ACTOR.ALICE)).toBeUndefined();
+      expect(await getPosition(ACTOR.BOB)).toBeDefined();
+
+      // Second batch closes the rest
+      await expectSuccess(SETTLE, { collateral: SYMBOL.EOS.toString(), limit: 10 }, ACTOR.CRON);
+      expect(await getPosition(ACTOR.BOB)).toBeUndefined();
+
+      // Users get (80.0000 ZIG - loan) / 8 EOS back without penalty
+      const aliceAfter = await getAccountBalance(CONTRACT.EOS, ACTOR.ALICE.name, 'EOS');
+      const bobAfter = await getAccountBalance(CONTRACT.EOS, ACTOR.BOB.name, 'EOS');
+      expect(Number(aliceAfter) - Number(aliceBefore)).toBeCloseTo((80 - aliceLoan) / 8, 3);
+      expect(Number(bobAfter) - Number(bobBefore)).toBeCloseTo((80 - bobLoan) / 8, 3);
+
+      // Liquidation account gets the rest
+      const liquidateAfter = await getAccountBalance(CONTRACT.EOS, ACTOR.LIQUIDATE.name, 'EOS');
+      expect(Number(liquidateAfter) - Number(liquidateBefore)).toBeCloseTo((aliceLoan + bobLoan) / 8, 3);
+    });
+
+    it(`${SETTLE}: success - nothing left to settle`, async () => {
+      await expectSuccess(SETTLE, { collateral: SYMBOL.EOS.toString(), limit: 10 }, ACTOR.CRON);
+    });
+  });
+
+});
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "fixture.hpp"
+
+/**
+ * Microbenchmarks of the contract logic running on the in-memory host
+ *
+ * Usage: zigzag_bench [positions]
+ **/
+
+namespace {
+
+   template <typename Fn>
+   void bench(const char* label, uint64_t iterations, Fn&& fn) {
+      auto start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < iterations; i++) {
+         fn(i);
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      std::printf("%-24s %10llu ops %12.0f ns/op\n", label, (unsigned long long)iterations, double(elapsed) / iterations);
+   }
+}
+
+int main(int argc, char** argv) {
+   const uint64_t positions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+
+   setup_chain();
+   auto& chain = host::chain::instance();
+
+   std::vector<name> users;
+   for (uint64_t i = 0; i < positions; i++) {
+      users.push_back(create_user(i, eos(100), asset(0, ZIG_SYMBOL)));
+   }
+
+   /** New position: loan, first interest and deferred interest scheduling **/
+   bench("loan (open)", positions, [&](uint64_t i) {
+      transfer(EOS_TOKEN, users[i], CONTRACT_NAME, eos(10));
+   });
+
+   bench("loan (top up)", positions, [&](uint64_t i) {
+      transfer(EOS_TOKEN, users[i], CONTRACT_NAME, eos(1));
+   });
+
+   bench("get_average_rate (2)", positions, [&](uint64_t) {
+      zigzag_native::get_average_rate(EOS_SYMBOL);
+   });
+
+   setrate(name("oracle.1"), EOS_SYMBOL, 6);
+   bench("get_average_rate (3)", positions, [&](uint64_t) {
+      zigzag_native::get_average_rate(EOS_SYMBOL);
+   });
+
+   /** Rate read from a price feed with a single datapoint instead of oracle rates **/
+   const name feed = name("price.feed");
+   chain.create_account(feed);
+   chain.run(feed, {}, [&]() {
+      zigzag_native::datapoint_index datapoints(feed, name("eosusd").value);
+      datapoints.emplace(feed, [&](auto& row) {
+         row.id = 0;
+         row.owner = feed;
+         row.median = 60000;
+         row.value = row.median;
+         row.timestamp = current_time_point();
+      });
+   });
+   chain.push(CONTRACT_NAME, name("setfeed"), CONTRACT_NAME, EOS_SYMBOL, feed, name("eosusd"), uint8_t(4), uint32_t(600), 1., 100.);
+   bench("get_average_rate (feed)", positions, [&](uint64_t) {
+      zigzag_native::get_average_rate(EOS_SYMBOL);
+   });
+   chain.push(CONTRACT_NAME, name("setfeed"), CONTRACT_NAME, EOS_SYMBOL, name(), name(), uint8_t(0), uint32_t(0), 0., 0.);
+   setrate(name("oracle.1"), EOS_SYMBOL, 6);
+   setrate(name("oracle.2"), EOS_SYMBOL, 4);
+   setrate(name("oracle.3"), EOS_SYMBOL, 8);
+
+   /** Interest is due for all positions, deferred transactions are not executed **/
+   chain.set_time(chain.now() + 86400);
+   bench("calcinterest (due)", positions, [&](uint64_t i) {
+      zigzag_native::calcinterest(users[i], EOS_SYMBOL);
+   });
+
+   bench("calcinterest (not due)", positions, [&](uint64_t i) {
+      zigzag_native::calcinterest(users[i], EOS_SYMBOL);
+   });
+
+   bench("liquidate (healthy)", positions, [&](uint64_t i) {
+      chain.push(CONTRACT_NAME, name("liquidate"), CRON_NAME, users[i], EOS_SYMBOL);
+   });
+
+   /** Drop the average rate below liquidation threshold **/
+   setrate(name("oracle.1"), EOS_SYMBOL, 1);
+   setrate(name("oracle.2"), EOS_SYMBOL, 1);
+   setrate(name("oracle.3"), EOS_SYMBOL, 1);
+   bench("liquidate (close)", positions, [&](uint64_t i) {
+      chain.push(CONTRACT_NAME, name("liquidate"), CRON_NAME, users[i], EOS_SYMBOL);
+   });
+
+   /** Reopened positions are due for liquidation at the average rate of 0.8333, setrate closes liquid.limit of them per rate move **/
+   for (uint64_t i = 0; i < positions; i++) {
+      transfer(EOS_TOKEN, users[i], CONTRACT_NAME, eos(10));
+   }
+   setparam("liquid.step", "0.05");
+   setparam("liquid.limit", "10");
+   chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, name(), uint32_t(positions));
+   setrate(name("oracle.2"), EOS_SYMBOL, 0.5);
+   bench("setrate (below step)", positions, [&](uint64_t) {
+      setrate(name("oracle.3"), EOS_SYMBOL, 1);
+   });
+
+   bench("setrate (liquidate 10)", positions / 10 - 1, [&](uint64_t i) {
+      setrate(name("oracle.1"), EOS_SYMBOL, i % 2 ? 1 : 0.8);
+   });
+
+   return EXIT_SUCCESS;
+}
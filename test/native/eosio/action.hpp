@@ -0,0 +1,44 @@
+#pragma once
+
+#include <any>
+#include <tuple>
+#include <vector>
+
+#include <eosio/name.hpp>
+#include <eosio/permission_level.hpp>
+
+#include "../host.hpp"
+
+/** Native stand-in for eosio/action.hpp, action data is kept as a tuple **/
+namespace eosio {
+
+   struct action {
+      eosio::name account;
+      eosio::name name;
+      std::vector<permission_level> authorization;
+      std::any data;
+
+      action() = default;
+
+      template <typename T>
+      action(const permission_level& auth, struct name a, struct name n, T&& value)
+         : account(a), name(n), authorization({ auth }), data(std::forward<T>(value)) {}
+
+      template <typename T>
+      action(std::vector<permission_level> auths, struct name a, struct name n, T&& value)
+         : account(a), name(n), authorization(std::move(auths)), data(std::forward<T>(value)) {}
+
+      host::action_data to_host() const {
+         return host::action_data{ account, name, authorization, data };
+      }
+
+      void send() const {
+         host::chain::instance().send_inline(to_host());
+      }
+   };
+
+   template <typename... Args>
+   void dispatch_inline(name code, name act, std::vector<permission_level> perms, std::tuple<Args...> args) {
+      action(std::move(perms), code, act, std::move(args)).send();
+   }
+}
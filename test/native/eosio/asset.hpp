@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+
+#include <eosio/check.hpp>
+#include <eosio/symbol.hpp>
+
+/** Native stand-in for eosio/asset.hpp **/
+namespace eosio {
+
+   struct asset {
+      static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+      int64_t amount = 0;
+      eosio::symbol symbol;
+
+      asset() = default;
+      asset(int64_t a, eosio::symbol s) : amount(a), symbol(s) {
+         check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+      }
+
+      bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+      bool is_valid() const { return is_amount_within_range() && symbol.is_valid(); }
+      void set_amount(int64_t a) {
+         amount = a;
+         check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+      }
+
+      asset operator-() const { return asset(-amount, symbol); }
+
+      asset& operator-=(const asset& a) {
+         check(a.symbol == symbol, "attempt to subtract asset with different symbol");
+         amount -= a.amount;
+         check(-max_amount <= amount, "subtraction underflow");
+         return *this;
+      }
+
+      asset& operator+=(const asset& a) {
+         check(a.symbol == symbol, "attempt to add asset with different symbol");
+         amount += a.amount;
+         check(amount <= max_amount, "addition overflow");
+         return *this;
+      }
+
+      friend asset operator+(const asset& a, const asset& b) {
+         asset result = a;
+         result += b;
+         return result;
+      }
+
+      friend asset operator-(const asset& a, const asset& b) {
+         asset result = a;
+         result -= b;
+         return result;
+      }
+
+      friend bool operator==(const asset& a, const asset& b) {
+         check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+         return a.amount == b.amount;
+      }
+      friend bool operator!=(const asset& a, const asset& b) { return !(a == b); }
+      friend bool operator<(const asset& a, const asset& b) {
+         check(a.symbol == b.symbol, "comparison of assets with different symbols is not allowed");
+         return a.amount < b.amount;
+      }
+      friend bool operator<=(const asset& a, const asset& b) { return !(b < a); }
+      friend bool operator>(const asset& a, const asset& b) { return b < a; }
+      friend bool operator>=(const asset& a, const asset& b) { return !(a < b); }
+
+      std::string to_string() const {
+         bool negative = amount < 0;
+         uint64_t abs_amount = negative ? -amount : amount;
+         std::string result = std::to_string(abs_amount);
+         uint8_t precision = symbol.precision();
+         if (precision > 0) {
+            if (result.size() <= precision) {
+               result.insert(0, precision - result.size() + 1, '0');
+            }
+            result.insert(result.size() - precision, ".");
+         }
+         return (negative ? "-" : "") + result + " " + symbol.code().to_string();
+      }
+
+      void print() const {}
+   };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <utility>
+
+#include <eosio/check.hpp>
+
+/**
+ * Native stand-in for eosio/binary_extension.hpp
+ * Rows are kept as objects, a row written before a field was added is a row with the extension left empty
+ **/
+namespace eosio {
+
+   template <typename T>
+   class binary_extension {
+   public:
+      constexpr binary_extension() = default;
+      constexpr binary_extension(const T& value) : _has_value(true), _value(value) {}
+      constexpr binary_extension(T&& value) : _has_value(true), _value(std::move(value)) {}
+
+      constexpr bool has_value() const { return _has_value; }
+      constexpr explicit operator bool() const { return _has_value; }
+
+      T& value() {
+         check(_has_value, "cannot get value of empty binary_extension");
+         return _value;
+      }
+      const T& value() const {
+         check(_has_value, "cannot get value of empty binary_extension");
+         return _value;
+      }
+
+      template <typename U>
+      T value_or(U&& def) const { return _has_value ? _value : static_cast<T>(std::forward<U>(def)); }
+      T value_or() const { return _has_value ? _value : T{}; }
+
+      T& operator*() { return value(); }
+      const T& operator*() const { return value(); }
+      T* operator->() { return &value(); }
+      const T* operator->() const { return &value(); }
+
+      template <typename... Args>
+      T& emplace(Args&&... args) {
+         _value = T(std::forward<Args>(args)...);
+         _has_value = true;
+         return _value;
+      }
+
+      void reset() {
+         _value = T{};
+         _has_value = false;
+      }
+
+   private:
+      bool _has_value = false;
+      T _value{};
+   };
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Native stand-in for eosio/check.hpp
+ * Failed check throws eosio_assert_exception, host rolls back the transaction
+ **/
+namespace eosio {
+
+   struct eosio_assert_exception : std::runtime_error {
+      using std::runtime_error::runtime_error;
+   };
+
+   inline void check(bool pred, const char* msg) {
+      if (!pred) {
+         throw eosio_assert_exception(msg);
+      }
+   }
+
+   inline void check(bool pred, const std::string& msg) {
+      if (!pred) {
+         throw eosio_assert_exception(msg);
+      }
+   }
+
+   inline void check(bool pred, const char* msg, size_t n) {
+      if (!pred) {
+         throw eosio_assert_exception(std::string(msg, n));
+      }
+   }
+
+   inline void check(bool pred, uint64_t code) {
+      if (!pred) {
+         throw eosio_assert_exception("assertion failure with error code: " + std::to_string(code));
+      }
+   }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+/** Native stand-in for eosio/datastream.hpp, action data is passed as tuples so the stream is never read **/
+namespace eosio {
+
+   template <typename T>
+   class datastream {
+   public:
+      datastream(T start, size_t size) : _start(start), _pos(start), _end(start + size) {}
+
+      T pos() const { return _pos; }
+      size_t remaining() const { return _end - _pos; }
+
+   private:
+      T _start;
+      T _pos;
+      T _end;
+   };
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <any>
+#include <tuple>
+#include <type_traits>
+
+#include <eosio/contract.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/name.hpp>
+
+#include "../host.hpp"
+
+/** Native stand-in for eosio/dispatcher.hpp, arguments are taken from the tuple of the current action **/
+namespace eosio {
+
+   template <typename T, typename R, typename... Args>
+   bool execute_action(name self, name code, R (T::*func)(Args...)) {
+      using args_type = std::tuple<std::decay_t<Args>...>;
+      const auto* args = std::any_cast<args_type>(&host::chain::instance().current_data());
+      check(args != nullptr, "action data does not match action arguments");
+
+      datastream<const char*> ds(nullptr, 0);
+      T inst(self, code, ds);
+      std::apply([&](auto... values) { (inst.*func)(values...); }, *args);
+      return true;
+   }
+}
+
+/** Sequence walk used instead of BOOST_PP_SEQ_FOR_EACH: (a)(b)(c) **/
+#define EOSIO_NATIVE_CAT(a, b) EOSIO_NATIVE_CAT_I(a, b)
+#define EOSIO_NATIVE_CAT_I(a, b) a##b
+#define EOSIO_NATIVE_DISPATCH_A(elem) EOSIO_NATIVE_DISPATCH_CASE(elem) EOSIO_NATIVE_DISPATCH_B
+#define EOSIO_NATIVE_DISPATCH_B(elem) EOSIO_NATIVE_DISPATCH_CASE(elem) EOSIO_NATIVE_DISPATCH_A
+#define EOSIO_NATIVE_DISPATCH_A_END
+#define EOSIO_NATIVE_DISPATCH_B_END
+#define EOSIO_NATIVE_DISPATCH_CASE(elem) \
+   case eosio::name(#elem).value: \
+      eosio::execute_action(eosio::name(receiver), eosio::name(code), &eosio_native_dispatch_type::elem); \
+      break;
+
+#define EOSIO_DISPATCH_HELPER(TYPE, MEMBERS) \
+   using eosio_native_dispatch_type = TYPE; \
+   EOSIO_NATIVE_CAT(EOSIO_NATIVE_DISPATCH_A MEMBERS, _END)
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <iterator>
+#include <memory>
+#include <set>
+#include <type_traits>
+#include <typeindex>
+
+#include <eosio/check.hpp>
+#include <eosio/name.hpp>
+
+#include "../host.hpp"
+
+/**
+ * Native stand-in for eosio/multi_index.hpp
+ *
+ * Rows live in host::chain tables. Secondary indices are ordered sets of (key, primary key) kept
+ * next to the rows and updated with every row change, iteration order is the one of the chain
+ * (key, then primary key). A table is bound to the row type of its first writer, reading it
+ * with another type is allowed only for trivially copyable types of the same size (token stat table
+ * read by the contract through its own struct)
+ **/
+namespace eosio {
+
+   /** Secondary key extractor calling a const member function of the row **/
+   template <class Class, typename Type, Type (Class::*PtrToMemberFunction)() const>
+   struct const_mem_fun {
+      using result_type = Type;
+
+      Type operator()(const Class& obj) const { return (obj.*PtrToMemberFunction)(); }
+   };
+
+   template <name::raw IndexName, typename Extractor>
+   struct indexed_by {
+      static constexpr name::raw index_name = IndexName;
+      using secondary_extractor_type = Extractor;
+   };
+
+   namespace detail {
+      template <typename T>
+      struct type_identity {
+         using type = T;
+      };
+
+      /** Index of the list with the name, compile error if there is none **/
+      template <name::raw IndexName, typename... Indices>
+      struct find_index;
+
+      template <name::raw IndexName, typename First, typename... Rest>
+      struct find_index<IndexName, First, Rest...> {
+         using type = typename std::conditional_t<First::index_name == IndexName,
+            type_identity<First>, find_index<IndexName, Rest...>>::type;
+      };
+   }
+
+   template <name::raw TableName, typename T, typename... Indices>
+   class multi_index {
+      using rows_type = std::map<uint64_t, std::shared_ptr<void>>;
+
+      template <typename Index>
+      using entries_type = std::set<std::pair<typename Index::secondary_extractor_type::result_type, uint64_t>>;
+
+   public:
+      class const_iterator {
+      public:
+         using iterator_category = std::bidirectional_iterator_tag;
+         using value_type = T;
+         using difference_type = std::ptrdiff_t;
+         using pointer = const T*;
+         using reference = const T&;
+
+         const_iterator() = default;
+         explicit const_iterator(typename rows_type::const_iterator itr) : _itr(itr) {}
+
+         const T& operator*() const { return *static_cast<const T*>(_itr->second.get()); }
+         const T* operator->() const { return static_cast<const T*>(_itr->second.get()); }
+
+         const_iterator& operator++() { ++_itr; return *this; }
+         const_iterator operator++(int) { auto copy = *this; ++_itr; return copy; }
+         const_iterator& operator--() { --_itr; return *this; }
+         const_iterator operator--(int) { auto copy = *this; --_itr; return copy; }
+
+         friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._itr == b._itr; }
+         friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._itr != b._itr; }
+
+      private:
+         friend class multi_index;
+         typename rows_type::const_iterator _itr;
+      };
+
+      template <typename Index>
+      class index {
+         using entries = entries_type<Index>;
+
+      public:
+         using secondary_key_type = typename Index::secondary_extractor_type::result_type;
+
+         class const_iterator {
+         public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T*;
+            using reference = const T&;
+
+            const_iterator() = default;
+            const_iterator(const host::table* table, typename entries::const_iterator itr) : _table(table), _itr(itr) {}
+
+            const T& operator*() const { return *static_cast<const T*>(_table->rows.find(_itr->second)->second.get()); }
+            const T* operator->() const { return &**this; }
+
+            const_iterator& operator++() { ++_itr; return *this; }
+            const_iterator operator++(int) { auto copy = *this; ++_itr; return copy; }
+            const_iterator& operator--() { --_itr; return *this; }
+            const_iterator operator--(int) { auto copy = *this; --_itr; return copy; }
+
+            friend bool operator==(const const_iterator& a, const const_iterator& b) { return a._itr == b._itr; }
+            friend bool operator!=(const const_iterator& a, const const_iterator& b) { return a._itr != b._itr; }
+
+         private:
+            const host::table* _table = nullptr;
+            typename entries::const_iterator _itr;
+         };
+
+         index(const host::table* table, const entries* set) : _table(table), _set(set) {}
+
+         const_iterator begin() const { return const_iterator(_table, _set->cbegin()); }
+         const_iterator end() const { return const_iterator(_table, _set->cend()); }
+         const_iterator cbegin() const { return begin(); }
+         const_iterator cend() const { return end(); }
+
+         const_iterator lower_bound(const secondary_key_type& key) const {
+            return const_iterator(_table, _set->lower_bound(std::make_pair(key, uint64_t(0))));
+         }
+
+         const_iterator upper_bound(const secondary_key_type& key) const {
+            return const_iterator(_table, _set->upper_bound(std::make_pair(key, UINT64_MAX)));
+         }
+
+         const_iterator find(const secondary_key_type& key) const {
+            auto itr = lower_bound(key);
+            return itr != end() && typename Index::secondary_extractor_type()(*itr) == key ? itr : end();
+         }
+
+      private:
+         const host::table* _table;
+         const entries* _set;
+      };
+
+      multi_index(name code, uint64_t scope)
+         : _code(code), _scope(scope), _table(&host::chain::instance().get_table(code, scope, name(TableName))) {
+         if (_table->type != typeid(void) && _table->type != typeid(T)) {
+            check(std::is_trivially_copyable<T>::value && _table->object_size == sizeof(T), "table row type mismatch");
+         }
+         (get_entries<Indices>(), ...);
+      }
+
+      name get_code() const { return _code; }
+      uint64_t get_scope() const { return _scope; }
+
+      const_iterator begin() const { return const_iterator(_table->rows.cbegin()); }
+      const_iterator end() const { return const_iterator(_table->rows.cend()); }
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend() const { return end(); }
+
+      const_iterator find(uint64_t primary) const { return const_iterator(_table->rows.find(primary)); }
+      const_iterator lower_bound(uint64_t primary) const { return const_iterator(_table->rows.lower_bound(primary)); }
+      const_iterator upper_bound(uint64_t primary) const { return const_iterator(_table->rows.upper_bound(primary)); }
+
+      const_iterator iterator_to(const T& obj) const { return find(obj.primary_key()); }
+
+      template <name::raw IndexName>
+      auto get_index() const {
+         using Index = typename detail::find_index<IndexName, Indices...>::type;
+         return index<Index>(_table, get_entries<Index>().get());
+      }
+
+      const T& get(uint64_t primary, const char* error_msg = "unable to find key") const {
+         auto itr = find(primary);
+         check(itr != end(), error_msg);
+         return *itr;
+      }
+
+      template <typename Lambda>
+      const_iterator emplace(name payer, Lambda&& constructor) {
+         check(_code == host::chain::instance().current_receiver(), "cannot create objects in table of another contract");
+         auto object = std::make_shared<T>();
+         constructor(*object);
+         uint64_t primary = object->primary_key();
+         check(_table->rows.find(primary) == _table->rows.end(), "could not insert object, most likely a uniqueness constraint was violated");
+
+         if (_table->type == typeid(void)) {
+            _table->type = typeid(T);
+            _table->object_size = sizeof(T);
+         }
+         (insert_entry<Indices>(*object), ...);
+         auto result = _table->rows.emplace(primary, std::move(object)).first;
+
+         auto table = _table;
+         host::chain::instance().on_undo([table, primary]() {
+            table->rows.erase(primary);
+         });
+         return const_iterator(result);
+      }
+
+      template <typename Lambda>
+      void modify(const_iterator itr, name payer, Lambda&& updater) {
+         check(itr != end(), "cannot pass end iterator to modify");
+         check(_code == host::chain::instance().current_receiver(), "cannot modify objects in table of another contract");
+         uint64_t primary = itr._itr->first;
+
+         /** Rows are replaced, not updated in place, so the old object can be restored on rollback **/
+         auto object = std::make_shared<T>(*itr);
+         updater(*object);
+         check(object->primary_key() == primary, "updater cannot change primary key when modifying an object");
+
+         (erase_entry<Indices>(*itr), ...);
+         (insert_entry<Indices>(*object), ...);
+         auto& slot = _table->rows.find(primary)->second;
+         auto previous = slot;
+         slot = std::move(object);
+
+         auto table = _table;
+         host::chain::instance().on_undo([table, primary, previous]() {
+            table->rows[primary] = previous;
+         });
+      }
+
+      template <typename Lambda>
+      void modify(const T& obj, name payer, Lambda&& updater) {
+         modify(find(obj.primary_key()), payer, std::forward<Lambda>(updater));
+      }
+
+      const_iterator erase(const_iterator itr) {
+         check(itr != end(), "cannot pass end iterator to erase");
+         check(_code == host::chain::instance().current_receiver(), "cannot erase objects in table of another contract");
+         uint64_t primary = itr._itr->first;
+         auto previous = itr._itr->second;
+         (erase_entry<Indices>(*itr), ...);
+         auto next = _table->rows.erase(itr._itr);
+
+         auto table = _table;
+         host::chain::instance().on_undo([table, primary, previous]() {
+            table->rows[primary] = previous;
+         });
+         return const_iterator(next);
+      }
+
+      void erase(const T& obj) {
+         erase(find(obj.primary_key()));
+      }
+
+   private:
+      /** Entries of the index, built from the rows when the table is opened with it first **/
+      template <typename Index>
+      std::shared_ptr<entries_type<Index>> get_entries() const {
+         auto& slot = _table->indices[uint64_t(Index::index_name)];
+         if (!slot) {
+            auto set = std::make_shared<entries_type<Index>>();
+            for (auto& [primary, object] : _table->rows) {
+               set->emplace(typename Index::secondary_extractor_type()(*static_cast<const T*>(object.get())), primary);
+            }
+            slot = set;
+         }
+         return std::static_pointer_cast<entries_type<Index>>(slot);
+      }
+
+      template <typename Index>
+      void insert_entry(const T& obj) {
+         auto set = get_entries<Index>();
+         auto entry = std::make_pair(typename Index::secondary_extractor_type()(obj), obj.primary_key());
+         set->insert(entry);
+         host::chain::instance().on_undo([set, entry]() {
+            set->erase(entry);
+         });
+      }
+
+      template <typename Index>
+      void erase_entry(const T& obj) {
+         auto set = get_entries<Index>();
+         auto entry = std::make_pair(typename Index::secondary_extractor_type()(obj), obj.primary_key());
+         set->erase(entry);
+         host::chain::instance().on_undo([set, entry]() {
+            set->insert(entry);
+         });
+      }
+
+      name _code;
+      uint64_t _scope;
+      host::table* _table;
+   };
+}
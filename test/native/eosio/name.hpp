@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+
+#include <eosio/check.hpp>
+
+/** Native stand-in for eosio/name.hpp **/
+namespace eosio {
+
+   struct name {
+      enum class raw : uint64_t {};
+
+      uint64_t value = 0;
+
+      constexpr name() = default;
+      constexpr explicit name(uint64_t v) : value(v) {}
+      constexpr explicit name(raw r) : value(static_cast<uint64_t>(r)) {}
+
+      constexpr explicit name(std::string_view str) {
+         if (str.size() > 13) {
+            check(false, "string is too long to be a valid name");
+         }
+         if (str.empty()) {
+            return;
+         }
+         auto n = std::min(str.size(), size_t(12));
+         for (size_t i = 0; i < n; ++i) {
+            value <<= 5;
+            value |= char_to_value(str[i]);
+         }
+         value <<= (4 + 5 * (12 - n));
+         if (str.size() == 13) {
+            uint64_t v = char_to_value(str[12]);
+            if (v > 0x0Full) {
+               check(false, "thirteenth character in name cannot be a letter that comes after j");
+            }
+            value |= v;
+         }
+      }
+
+      static constexpr uint8_t char_to_value(char c) {
+         if (c == '.') {
+            return 0;
+         } else if (c >= '1' && c <= '5') {
+            return (c - '1') + 1;
+         } else if (c >= 'a' && c <= 'z') {
+            return (c - 'a') + 6;
+         }
+         check(false, "character is not in allowed character set for names");
+         return 0;
+      }
+
+      constexpr operator raw() const { return raw(value); }
+      constexpr explicit operator bool() const { return value != 0; }
+
+      std::string to_string() const {
+         static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+         std::string str(13, '.');
+         uint64_t tmp = value;
+         for (uint32_t i = 0; i <= 12; ++i) {
+            char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+            str[12 - i] = c;
+            tmp >>= (i == 0 ? 4 : 5);
+         }
+         auto last = str.find_last_not_of('.');
+         return last == std::string::npos ? std::string() : str.substr(0, last + 1);
+      }
+
+      void print() const {}
+
+      friend constexpr bool operator==(const name& a, const name& b) { return a.value == b.value; }
+      friend constexpr bool operator!=(const name& a, const name& b) { return a.value != b.value; }
+      friend constexpr bool operator<(const name& a, const name& b) { return a.value < b.value; }
+   };
+}
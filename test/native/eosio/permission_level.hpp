@@ -0,0 +1,17 @@
+#pragma once
+
+#include <eosio/name.hpp>
+
+/** Native stand-in for permission_level from eosio/action.hpp **/
+namespace eosio {
+
+   struct permission_level {
+      name actor;
+      name permission;
+
+      permission_level() = default;
+      permission_level(name a, name p) : actor(a), permission(p) {}
+   };
+}
+
+typedef unsigned __int128 uint128_t;
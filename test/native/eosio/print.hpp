@@ -0,0 +1,8 @@
+#pragma once
+
+/** Native stand-in for eosio/print.hpp, console output is dropped **/
+namespace eosio {
+
+   template <typename... Args>
+   inline void print(Args&&...) {}
+}
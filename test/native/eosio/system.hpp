@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#include <eosio/name.hpp>
+
+#include "../host.hpp"
+
+/** Native stand-in for eosio/system.hpp and the authorization intrinsics **/
+namespace eosio {
+
+   class microseconds {
+   public:
+      explicit constexpr microseconds(int64_t c = 0) : _count(c) {}
+      constexpr int64_t count() const { return _count; }
+
+   private:
+      int64_t _count;
+   };
+
+   class time_point {
+   public:
+      explicit constexpr time_point(microseconds e = microseconds()) : elapsed(e) {}
+      constexpr const microseconds& time_since_epoch() const { return elapsed; }
+      constexpr uint32_t sec_since_epoch() const { return uint32_t(elapsed.count() / 1000000); }
+
+      microseconds elapsed;
+   };
+
+   class time_point_sec {
+   public:
+      constexpr time_point_sec() : utc_seconds(0) {}
+      constexpr explicit time_point_sec(uint32_t seconds) : utc_seconds(seconds) {}
+      constexpr uint32_t sec_since_epoch() const { return utc_seconds; }
+
+      uint32_t utc_seconds;
+   };
+
+   inline time_point current_time_point() {
+      return time_point(microseconds(int64_t(host::chain::instance().now()) * 1000000));
+   }
+
+   inline time_point_sec current_time_point_sec() {
+      return time_point_sec(host::chain::instance().now());
+   }
+
+   inline void require_auth(name account) {
+      host::chain::instance().require_auth(account);
+   }
+
+   inline bool has_auth(name account) {
+      return host::chain::instance().has_auth(account);
+   }
+
+   inline bool is_account(name account) {
+      return host::chain::instance().is_account(account);
+   }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include <eosio/action.hpp>
+
+#include "../host.hpp"
+
+/** Native stand-in for eosio/transaction.hpp, deferred transactions are kept by host::chain **/
+namespace eosio {
+
+   class transaction {
+   public:
+      std::vector<action> actions;
+      uint32_t delay_sec = 0;
+
+      void send(const uint128_t& sender_id, name payer, bool replace_existing = false) const {
+         std::vector<host::action_data> host_actions;
+         for (auto& act : actions) {
+            host_actions.push_back(act.to_host());
+         }
+         host::chain::instance().send_deferred(sender_id, payer, std::move(host_actions), delay_sec, replace_existing);
+      }
+   };
+
+   inline int cancel_deferred(const uint128_t& sender_id) {
+      return host::chain::instance().cancel_deferred(sender_id);
+   }
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "zigzag.errors.hpp"
+
+/**
+ * Mirrors of the error list
+ *
+ * ZIGZAG_ERRORS in src/zigzag.errors.hpp is the list, the README.md error table and ERROR in
+ * test/constants.ts must have the same codes with the same messages in the same order
+ *
+ * Usage: zigzag_errors_test [repository root]
+ **/
+
+namespace {
+
+   int failures = 0;
+
+   void expect(bool condition, const std::string& message) {
+      if (!condition) {
+         std::fprintf(stderr, "%s\n", message.c_str());
+         failures++;
+      }
+   }
+
+   /** (id, "ZZ<code>: <message>") in list order, id is empty where the mirror has none **/
+   using error_list = std::vector<std::pair<std::string, std::string>>;
+
+   std::vector<std::string> read_lines(const std::string& path) {
+      std::ifstream in(path);
+      expect(in.is_open(), "can not open " + path);
+      std::vector<std::string> lines;
+      for (std::string line; std::getline(in, line);) {
+         lines.push_back(line);
+      }
+      return lines;
+   }
+
+   /** Rows of the table under "## Error codes": | ZZ101 | Unauthorized | **/
+   error_list read_readme(const std::string& path) {
+      const std::regex row(R"(^\| (ZZ\d+) \| (.*[^ ]) *\|$)");
+      error_list result;
+      bool is_section = false;
+      for (auto& line : read_lines(path)) {
+         if (line.rfind("## ", 0) == 0) {
+            is_section = line == "## Error codes";
+            continue;
+         }
+         std::smatch match;
+         if (is_section && std::regex_match(line, match, row)) {
+            result.emplace_back("", match[1].str() + ": " + match[2].str());
+         }
+      }
+      return result;
+   }
+
+   /** Entries of "export const ERROR = {": ID: 'ZZ101: Unauthorized', **/
+   error_list read_constants(const std::string& path) {
+      const std::regex entry(R"(^  ([A-Z_]+): '(ZZ\d+: [^']*)',?$)");
+      error_list result;
+      bool is_object = false;
+      for (auto& line : read_lines(path)) {
+         if (line == "export const ERROR = {") {
+            is_object = true;
+         } else if (is_object && line == "}") {
+            break;
+         } else if (is_object) {
+            std::smatch match;
+            expect(std::regex_match(line, match, entry), "test/constants.ts: unexpected ERROR line: " + line);
+            if (!match.empty()) {
+               result.emplace_back(match[1].str(), match[2].str());
+            }
+         }
+      }
+      return result;
+   }
+
+   void compare(const std::string& mirror, const error_list& expected, const error_list& actual, bool has_ids) {
+      expect(actual.size() == expected.size(), mirror + ": " + std::to_string(actual.size()) + " errors, "
+         + std::to_string(expected.size()) + " in src/zigzag.errors.hpp");
+      for (size_t i = 0; i < std::min(expected.size(), actual.size()); i++) {
+         expect(actual[i].second == expected[i].second, mirror + ": '" + actual[i].second + "', expected '" + expected[i].second + "'");
+         expect(!has_ids || actual[i].first == expected[i].first, mirror + ": " + actual[i].first + ", expected " + expected[i].first);
+      }
+   }
+}
+
+int main(int argc, char** argv) {
+   const std::string root = argc > 1 ? argv[1] : ".";
+
+   const error_list expected = {
+#define ZIGZAG_ERROR_ITEM(code, id, message) { #id, "ZZ" #code ": " message },
+      ZIGZAG_ERRORS(ZIGZAG_ERROR_ITEM)
+#undef ZIGZAG_ERROR_ITEM
+   };
+
+   compare("README.md", expected, read_readme(root + "/README.md"), false);
+   compare("test/constants.ts", expected, read_constants(root + "/test/constants.ts"), true);
+
+   std::printf("%s\n", failures == 0 ? "errors passed" : "errors failed");
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
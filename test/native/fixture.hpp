@@ -0,0 +1,173 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+
+#include "host.hpp"
+#include "zigzag.hpp"
+
+/**
+ * Contract state used by native tests and benchmarks, mirrors scripts/node-start.sh
+ **/
+#define CONTRACT_NAME name("zigzag")
+#define EOS_TOKEN name("eosio.token")
+#define EOS_SYMBOL symbol("EOS", 4)
+#define CRON_NAME name("actor.cron")
+#define LIQUIDATE_NAME name("liquid.addr")
+
+/** Access to contract internals, declared friend in zigzag.hpp for ZIGZAG_NATIVE builds **/
+struct zigzag_native {
+   using position_item = zigzag::position_item;
+   using position_index = zigzag::position_index;
+   using order_index = zigzag::order_index;
+   using datapoint_index = zigzag::datapoint_index;
+   using collateral_item = zigzag::collateral_item;
+   using collateral_index = zigzag::collateral_index;
+   using oracle_index = zigzag::oracle_index;
+   using legacy_oracle_index = zigzag::legacy_oracle_index;
+   using rate_index = zigzag::rate_index;
+
+   static zigzag make() {
+      datastream<const char*> ds(nullptr, 0);
+      return zigzag(CONTRACT_NAME, CONTRACT_NAME, ds);
+   }
+
+   static double get_average_rate(symbol collateral) {
+      double rate = 0;
+      host::chain::instance().run(CONTRACT_NAME, {}, [&]() {
+         rate = make().get_average_rate(collateral);
+      });
+      return rate;
+   }
+
+   static asset calcinterest(name user, symbol collateral) {
+      asset interest;
+      host::chain::instance().run(CONTRACT_NAME, { permission_level(CONTRACT_NAME, name("active")) }, [&]() {
+         interest = make().calcinterest(user, collateral, false);
+      });
+      return interest;
+   }
+
+   static void for_each_position(symbol collateral, const std::function<void(const position_item&)>& fn) {
+      position_index positions(CONTRACT_NAME, collateral.code().raw());
+      for (auto itr = positions.begin(); itr != positions.end(); itr++) {
+         fn(*itr);
+      }
+   }
+
+   static std::optional<position_item> find_position(name user, symbol collateral) {
+      position_index positions(CONTRACT_NAME, collateral.code().raw());
+      auto itr = positions.find(user.value);
+      return itr == positions.end() ? std::nullopt : std::optional<position_item>(*itr);
+   }
+
+   static uint128_t get_deferred_tx_id(name user, symbol collateral) {
+      return make().get_deferred_tx_id(user, collateral);
+   }
+
+#ifdef ZIGZAG_STATS
+   using stat_item = zigzag::stat_item;
+   using stat_index = zigzag::stat_index;
+
+   /** Counters of the action in the scope, zero when there is no row **/
+   static stat_item get_stat(uint64_t scope, name action) {
+      stat_index stats(CONTRACT_NAME, scope);
+      auto itr = stats.find(action.value);
+      return itr == stats.end() ? stat_item{ action, 0, 0, 0, 0 } : *itr;
+   }
+
+   static bool has_stats(uint64_t scope) {
+      stat_index stats(CONTRACT_NAME, scope);
+      return stats.begin() != stats.end();
+   }
+#endif
+};
+
+/** Unique valid account name for the index **/
+inline name user_name(uint64_t index) {
+   static const char* charmap = "abcdefghijklmnopqrstuvwxyz12345";
+   std::string str = "u";
+   do {
+      str += charmap[index % 31];
+      index /= 31;
+   } while (index > 0);
+   return name(str);
+}
+
+inline asset eos(double amount) {
+   return asset(int64_t(amount * 10000), EOS_SYMBOL);
+}
+
+inline asset zig(double amount) {
+   return asset(int64_t(amount * 10000), ZIG_SYMBOL);
+}
+
+inline void transfer(name token, name from, name to, asset quantity, std::string memo = "") {
+   host::chain::instance().push(token, name("transfer"), from, from, to, quantity, memo);
+}
+
+inline bool try_transfer(name token, name from, name to, asset quantity, std::string memo = "") {
+   return host::chain::instance().try_push(token, name("transfer"), from, from, to, quantity, memo);
+}
+
+/** Repayment memo entry with ZIG amount, "EOS:1.2345" **/
+inline std::string repay_memo(symbol collateral, asset amount) {
+   std::string str = amount.to_string();
+   return collateral.code().to_string() + ":" + str.substr(0, str.find(' '));
+}
+
+inline void setparam(const std::string& key, const std::string& value) {
+   host::chain::instance().push(CONTRACT_NAME, name("setparam"), CONTRACT_NAME, name(key), value);
+}
+
+inline void setrate(name oracle, symbol collateral, double rate) {
+   host::chain::instance().push(CONTRACT_NAME, name("setrate"), oracle, oracle, collateral, rate);
+}
+
+/** Fresh chain with contract, tokens, params, EOS collateral and oracles (rates 4 and 8) **/
+inline void setup_chain() {
+   auto& chain = host::chain::instance();
+   chain.reset();
+
+   chain.set_contract(CONTRACT_NAME);
+   for (auto account : { "actor.managr", "actor.cron", "liquid.addr", "oracle.1", "oracle.2", "oracle.3" }) {
+      chain.create_account(name(account));
+   }
+
+   chain.create_token(EOS_TOKEN, asset(10000000000000LL, EOS_SYMBOL));
+   chain.create_token(ZIGZAG_NAME, asset(10000000000000LL, ZIG_SYMBOL));
+   chain.issue(ZIGZAG_NAME, CONTRACT_NAME, zig(100000000));
+
+   setparam("max.oracles", "10");
+   setparam("position.def", "1.5");
+   setparam("interest.def", "0.001");
+   setparam("interest.int", "86400");
+   setparam("liquidate.th", "1.4");
+   setparam("penalty", "0.15");
+   setparam("manager", "actor.managr");
+   setparam("cron.account", "actor.cron");
+   setparam("liquid.addr", "liquid.addr");
+
+   chain.push(CONTRACT_NAME, name("addcollater"), CONTRACT_NAME, EOS_SYMBOL, EOS_TOKEN);
+   chain.push(CONTRACT_NAME, name("setcollater"), CONTRACT_NAME, EOS_SYMBOL, true);
+   for (auto oracle : { "oracle.1", "oracle.2", "oracle.3" }) {
+      chain.push(CONTRACT_NAME, name("addoracle"), CONTRACT_NAME, name(oracle), std::vector<symbol>{ EOS_SYMBOL });
+   }
+   setrate(name("oracle.2"), EOS_SYMBOL, 4);
+   setrate(name("oracle.3"), EOS_SYMBOL, 8);
+}
+
+/** Create user account with EOS and ZIG balances **/
+inline name create_user(uint64_t index, asset eos_amount, asset zig_amount) {
+   auto& chain = host::chain::instance();
+   name user = user_name(index);
+   chain.create_account(user);
+   if (eos_amount.amount > 0) {
+      chain.issue(EOS_TOKEN, user, eos_amount);
+   }
+   if (zig_amount.amount > 0) {
+      chain.issue(ZIGZAG_NAME, user, zig_amount);
+   }
+   return user;
+}
@@ -0,0 +1,321 @@
+#include "host.hpp"
+
+#include <eosio/check.hpp>
+
+/** Contract entry point, compiled from src/zigzag.cpp **/
+extern "C" void apply(uint64_t receiver, uint64_t code, uint64_t action);
+
+namespace host {
+
+   using eosio::check;
+
+   namespace {
+      /** Same layout as eosio.token stat table row **/
+      struct currency_stats {
+         asset supply;
+         asset max_supply;
+         name issuer;
+
+         uint64_t primary_key() const { return supply.symbol.code().raw(); }
+      };
+
+      const name TRANSFER = name("transfer");
+      const name STAT = name("stat");
+      const name ACTIVE = name("active");
+   }
+
+   chain& chain::instance() {
+      static chain instance;
+      return instance;
+   }
+
+   void chain::reset() {
+      auto observer = std::move(_observer);
+      *this = chain();
+      _observer = std::move(observer);
+   }
+
+   void chain::create_account(name account) {
+      _accounts.insert(account.value);
+   }
+
+   bool chain::is_account(name account) const {
+      return _accounts.count(account.value) > 0;
+   }
+
+   void chain::set_contract(name account) {
+      create_account(account);
+      _contract = account;
+   }
+
+   void chain::create_token(name token, asset max_supply) {
+      create_account(token);
+      _tokens.insert(token.value);
+
+      auto& stats = get_table(token, max_supply.symbol.code().raw(), STAT);
+      check(stats.rows.empty(), "token with symbol already exists");
+      auto object = std::make_shared<currency_stats>();
+      object->supply = asset(0, max_supply.symbol);
+      object->max_supply = max_supply;
+      object->issuer = token;
+      stats.type = typeid(currency_stats);
+      stats.object_size = sizeof(currency_stats);
+      stats.rows.emplace(object->primary_key(), object);
+   }
+
+   void chain::issue(name token, name to, asset quantity) {
+      auto& stats = get_table(token, quantity.symbol.code().raw(), STAT);
+      check(!stats.rows.empty(), "token with symbol does not exist");
+      auto* object = static_cast<currency_stats*>(stats.rows.begin()->second.get());
+      check(object->supply.symbol == quantity.symbol, "symbol precision mismatch");
+      object->supply += quantity;
+      check(object->supply <= object->max_supply, "quantity exceeds available supply");
+      add_balance(token, to, quantity);
+   }
+
+   asset chain::get_balance(name token, name account, symbol sym) const {
+      auto itr = _balances.find(std::make_tuple(token.value, account.value, sym.code().raw()));
+      return asset(itr == _balances.end() ? 0 : itr->second, sym);
+   }
+
+   asset chain::get_supply(name token, symbol sym) const {
+      auto itr = _tables.find(std::make_tuple(token.value, sym.code().raw(), STAT.value));
+      check(itr != _tables.end() && !itr->second.rows.empty(), "token with symbol does not exist");
+      return static_cast<const currency_stats*>(itr->second.rows.begin()->second.get())->supply;
+   }
+
+   void chain::add_balance(name token, name account, asset quantity) {
+      auto key = std::make_tuple(token.value, account.value, quantity.symbol.code().raw());
+      int64_t previous = _balances[key];
+      _balances[key] = previous + quantity.amount;
+      if (_in_transaction) {
+         on_undo([this, key, previous]() {
+            _balances[key] = previous;
+         });
+      }
+   }
+
+   void chain::advance_time(uint32_t sec) {
+      const uint32_t target = _now + sec;
+      while (!_deferred_schedule.empty() && _deferred_schedule.begin()->first <= target) {
+         auto key = _deferred_schedule.begin()->second;
+         auto itr = _deferred.find(key);
+         _now = std::max(_now, itr->second.delay_until);
+         deferred_transaction tx = itr->second;
+         erase_deferred(itr);
+
+         /** Failed deferred transaction is dropped, as on chain **/
+         try {
+            transaction([&]() {
+               for (auto& act : tx.actions) {
+                  execute(act);
+               }
+            });
+         } catch (const std::exception& e) {
+            _last_error = e.what();
+            _failed_deferred++;
+         }
+      }
+      _now = target;
+   }
+
+   const deferred_transaction* chain::find_deferred(name sender, const uint128_t& sender_id) const {
+      auto itr = _deferred.find(deferred_key{ sender.value, sender_id });
+      return itr == _deferred.end() ? nullptr : &itr->second;
+   }
+
+   void chain::push_action(name account, name action, std::vector<permission_level> authorization, std::any data) {
+      action_data act{ account, action, std::move(authorization), std::move(data) };
+      transaction([&]() {
+         execute(act);
+      });
+   }
+
+   void chain::run(name receiver, std::vector<permission_level> authorization, const std::function<void()>& fn) {
+      action_data act{ receiver, name(), std::move(authorization), std::any() };
+      transaction([&]() {
+         std::vector<action_data> inline_actions;
+         _frames.push_back(frame{ receiver, &act, &inline_actions });
+         try {
+            fn();
+         } catch (...) {
+            _frames.pop_back();
+            throw;
+         }
+         _frames.pop_back();
+         for (auto& inline_action : inline_actions) {
+            execute(inline_action);
+         }
+      });
+   }
+
+   void chain::transaction(const std::function<void()>& fn) {
+      check(!_in_transaction, "nested transactions are not supported");
+      _in_transaction = true;
+      _undo.clear();
+      try {
+         fn();
+      } catch (...) {
+         for (auto itr = _undo.rbegin(); itr != _undo.rend(); itr++) {
+            (*itr)();
+         }
+         _undo.clear();
+         _frames.clear();
+         _observed.clear();
+         _in_transaction = false;
+         throw;
+      }
+      _undo.clear();
+      _in_transaction = false;
+
+      /** Observed actions are reported only after commit **/
+      auto observed = std::move(_observed);
+      _observed.clear();
+      for (auto& [time, action] : observed) {
+         _observer(time, action);
+      }
+   }
+
+   void chain::execute(const action_data& action) {
+      std::vector<action_data> inline_actions;
+      std::vector<name> notify;
+
+      _frames.push_back(frame{ action.account, &action, &inline_actions });
+      dispatch(action.account, action, notify);
+      for (size_t i = 0; i < notify.size(); i++) {
+         _frames.back().receiver = notify[i];
+         dispatch(notify[i], action, notify);
+      }
+      _frames.pop_back();
+
+      for (auto& inline_action : inline_actions) {
+         execute(inline_action);
+      }
+   }
+
+   void chain::dispatch(name receiver, const action_data& action, std::vector<name>& notify) {
+      _executed_actions++;
+      if (receiver == action.account && _tokens.count(receiver.value) > 0) {
+         check(action.action == TRANSFER, "unsupported token action");
+         token_transfer(action, notify);
+      } else if (receiver == _contract) {
+         ::apply(receiver.value, action.account.value, action.action.value);
+         if (_observer) {
+            _observed.emplace_back(_now, action);
+         }
+      }
+   }
+
+   void chain::token_transfer(const action_data& action, std::vector<name>& notify) {
+      const auto* args = std::any_cast<std::tuple<name, name, asset, std::string>>(&action.data);
+      check(args != nullptr, "action data does not match action arguments");
+      const auto& [from, to, quantity, memo] = *args;
+
+      check(from != to, "cannot transfer to self");
+      require_auth(from);
+      check(is_account(to), "to account does not exist");
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must transfer positive quantity");
+      check(get_supply(action.account, quantity.symbol).symbol == quantity.symbol, "symbol precision mismatch");
+      check(memo.size() <= 256, "memo has more than 256 bytes");
+      check(get_balance(action.account, from, quantity.symbol) >= quantity, "overdrawn balance");
+
+      add_balance(action.account, from, -quantity);
+      add_balance(action.account, to, quantity);
+
+      notify.push_back(from);
+      notify.push_back(to);
+   }
+
+   const std::any& chain::current_data() const {
+      check(!_frames.empty(), "no action is executed");
+      return _frames.back().action->data;
+   }
+
+   name chain::current_receiver() const {
+      return _frames.empty() ? name() : _frames.back().receiver;
+   }
+
+   bool chain::has_auth(name account) const {
+      if (_frames.empty()) {
+         return false;
+      }
+      for (auto& level : _frames.back().action->authorization) {
+         if (level.actor == account) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   void chain::require_auth(name account) const {
+      check(has_auth(account), "missing authority of " + account.to_string());
+   }
+
+   void chain::send_inline(action_data action) {
+      check(!_frames.empty(), "inline actions can be sent only from an action");
+
+      /** Contract can use only its own permissions **/
+      for (auto& level : action.authorization) {
+         check(level.actor == _frames.back().receiver, "inline action authorized by another account");
+      }
+      _frames.back().inline_actions->push_back(std::move(action));
+   }
+
+   void chain::send_deferred(const uint128_t& sender_id, name payer, std::vector<action_data> actions, uint32_t delay_sec, bool replace) {
+      const deferred_key key{ current_receiver().value, sender_id };
+      auto itr = _deferred.find(key);
+      if (itr != _deferred.end()) {
+         check(replace, "deferred transaction with the same sender_id and payer already exists");
+         deferred_transaction previous = itr->second;
+         erase_deferred(itr);
+         on_undo([this, key, previous]() {
+            _deferred_schedule.emplace(previous.delay_until, key);
+            _deferred.emplace(key, previous);
+         });
+      }
+
+      deferred_transaction tx{ current_receiver(), sender_id, _now + delay_sec, std::move(actions) };
+      _deferred_schedule.emplace(tx.delay_until, key);
+      _deferred.emplace(key, std::move(tx));
+      on_undo([this, key]() {
+         erase_deferred(_deferred.find(key));
+      });
+   }
+
+   bool chain::cancel_deferred(const uint128_t& sender_id) {
+      const deferred_key key{ current_receiver().value, sender_id };
+      auto itr = _deferred.find(key);
+      if (itr == _deferred.end()) {
+         return false;
+      }
+      deferred_transaction previous = itr->second;
+      erase_deferred(itr);
+      on_undo([this, key, previous]() {
+         _deferred_schedule.emplace(previous.delay_until, key);
+         _deferred.emplace(key, previous);
+      });
+      return true;
+   }
+
+   void chain::erase_deferred(std::map<deferred_key, deferred_transaction>::iterator itr) {
+      auto range = _deferred_schedule.equal_range(itr->second.delay_until);
+      for (auto schedule = range.first; schedule != range.second; schedule++) {
+         if (!(schedule->second < itr->first) && !(itr->first < schedule->second)) {
+            _deferred_schedule.erase(schedule);
+            break;
+         }
+      }
+      _deferred.erase(itr);
+   }
+
+   table& chain::get_table(name code, uint64_t scope, name table_name) {
+      return _tables[std::make_tuple(code.value, scope, table_name.value)];
+   }
+
+   void chain::on_undo(std::function<void()> undo) {
+      if (_in_transaction) {
+         _undo.push_back(std::move(undo));
+      }
+   }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <any>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <vector>
+
+#include <eosio/asset.hpp>
+#include <eosio/name.hpp>
+#include <eosio/permission_level.hpp>
+
+/**
+ * In-memory chain used by the native build of the contract
+ *
+ * Keeps multi_index tables, token balances, deferred transactions and the clock in process memory.
+ * Actions are executed the way nodeos does it: receiver first, then notified accounts, then inline
+ * actions depth first. A failed check rolls back every change made by the transaction.
+ *
+ * Action data is passed as std::tuple of the action arguments instead of serialized bytes,
+ * so the tuple types must match the action signature exactly (std::string, not const char*)
+ **/
+namespace host {
+
+   using eosio::asset;
+   using eosio::name;
+   using eosio::permission_level;
+   using eosio::symbol;
+
+   /** Rows of a single table (code, scope, table), objects are owned by the table **/
+   struct table {
+      std::map<uint64_t, std::shared_ptr<void>> rows;
+      std::map<uint64_t, std::shared_ptr<void>> indices;   // Secondary index entries by index name, owned by multi_index
+      std::type_index type = typeid(void);
+      size_t object_size = 0;
+   };
+
+   struct action_data {
+      name account;
+      name action;
+      std::vector<permission_level> authorization;
+      std::any data;
+   };
+
+   struct deferred_transaction {
+      name sender;
+      uint128_t sender_id;
+      uint32_t delay_until;
+      std::vector<action_data> actions;
+   };
+
+   class chain {
+   public:
+      /** Chain used by the contract code, reset() brings it to the empty state (action observer is kept) **/
+      static chain& instance();
+      void reset();
+
+      /** Accounts and contracts **/
+      void create_account(name account);
+      bool is_account(name account) const;
+      void set_contract(name account);
+
+      /** Tokens, with the same transfer rules and notifications as eosio.token **/
+      void create_token(name token, asset max_supply);
+      void issue(name token, name to, asset quantity);
+      asset get_balance(name token, name account, symbol sym) const;
+      asset get_supply(name token, symbol sym) const;
+
+      /** Clock, advancing it executes deferred transactions which became due **/
+      uint32_t now() const { return _now; }
+      void set_time(uint32_t sec) { _now = sec; }
+      void advance_time(uint32_t sec);
+
+      /** Deferred transactions scheduled by the contract **/
+      const deferred_transaction* find_deferred(name sender, const uint128_t& sender_id) const;
+      size_t deferred_count() const { return _deferred.size(); }
+      uint64_t failed_deferred() const { return _failed_deferred; }
+
+      /** Push a single action transaction, throws eosio_assert_exception after rollback on failure **/
+      void push_action(name account, name action, std::vector<permission_level> authorization, std::any data);
+
+      template <typename... Args>
+      void push(name account, name action, name actor, Args... args) {
+         push_action(account, action, { permission_level(actor, name("active")) }, std::make_tuple(args...));
+      }
+
+      /** Same as push, returns false instead of throwing **/
+      template <typename... Args>
+      bool try_push(name account, name action, name actor, Args... args) {
+         try {
+            push(account, action, actor, args...);
+            return true;
+         } catch (const std::exception& e) {
+            _last_error = e.what();
+            return false;
+         }
+      }
+
+      /** Run arbitrary code as a transaction in the receiver context (used to reach contract internals) **/
+      void run(name receiver, std::vector<permission_level> authorization, const std::function<void()>& fn);
+
+      /** Observer of committed actions executed by the contract (own actions and notifications), in execution order **/
+      using action_observer = std::function<void(uint32_t time, const action_data& action)>;
+      void set_action_observer(action_observer observer) { _observer = std::move(observer); }
+
+      const std::string& last_error() const { return _last_error; }
+      uint64_t executed_actions() const { return _executed_actions; }
+
+      /** Calls made by the contract code **/
+      const std::any& current_data() const;
+      name current_receiver() const;
+      bool has_auth(name account) const;
+      void require_auth(name account) const;
+      void send_inline(action_data action);
+      void send_deferred(const uint128_t& sender_id, name payer, std::vector<action_data> actions, uint32_t delay_sec, bool replace);
+      bool cancel_deferred(const uint128_t& sender_id);
+      table& get_table(name code, uint64_t scope, name table_name);
+
+      /** Register undo step of the current transaction **/
+      void on_undo(std::function<void()> undo);
+
+   private:
+      struct frame {
+         name receiver;
+         const action_data* action;
+         std::vector<action_data>* inline_actions;
+      };
+
+      struct deferred_key {
+         uint64_t sender;
+         uint128_t sender_id;
+         bool operator<(const deferred_key& other) const {
+            return sender != other.sender ? sender < other.sender : sender_id < other.sender_id;
+         }
+      };
+
+      void execute(const action_data& action);
+      void dispatch(name receiver, const action_data& action, std::vector<name>& notify);
+      void token_transfer(const action_data& action, std::vector<name>& notify);
+      void transaction(const std::function<void()>& fn);
+      void add_balance(name token, name account, asset quantity);
+      void erase_deferred(std::map<deferred_key, deferred_transaction>::iterator itr);
+
+      uint32_t _now = 1500000000;
+      name _contract;
+      std::set<uint64_t> _accounts;
+      std::set<uint64_t> _tokens;
+      std::map<std::tuple<uint64_t, uint64_t, uint64_t>, int64_t> _balances;
+      std::map<std::tuple<uint64_t, uint64_t, uint64_t>, table> _tables;
+      std::map<deferred_key, deferred_transaction> _deferred;
+      std::multimap<uint32_t, deferred_key> _deferred_schedule;
+
+      std::vector<frame> _frames;
+      std::vector<std::function<void()>> _undo;
+      bool _in_transaction = false;
+      std::string _last_error;
+      uint64_t _executed_actions = 0;
+      uint64_t _failed_deferred = 0;
+
+      action_observer _observer;
+      std::vector<std::pair<uint32_t, action_data>> _observed;
+   };
+}
@@ -0,0 +1,314 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "fixture.hpp"
+
+#include "book.hpp"
+#include "snapshot.hpp"
+#include "trace.hpp"
+
+/**
+ * Off-chain indexer (tools/indexer) against the contract
+ *
+ * Contract actions are written to a trace file as they are committed, the indexer follows the file
+ * and its book must match the contract positions table exactly after every batch. Halfway through
+ * the indexer is restarted from a snapshot.
+ *
+ * Usage: zigzag_indexer_test [steps] [seed]
+ **/
+
+namespace {
+
+   const uint64_t USERS = 50;
+   const uint64_t BATCH = 100;
+   const char* TRACE_PATH = "indexer_trace.txt";
+   const char* ESCAPED_MEMO = "tab\there\nnew line\\n\\\r";
+   const char* SNAPSHOT_PATH = "indexer_snapshot.bin";
+
+   int failures = 0;
+
+   void fail(uint64_t step, const std::string& message) {
+      std::fprintf(stderr, "step %llu: %s\n", (unsigned long long)step, message.c_str());
+      failures++;
+   }
+
+   /** Trace form of action arguments **/
+   std::string to_trace_arg(name value) { return value.to_string(); }
+   std::string to_trace_arg(symbol value) { return value.to_string(); }
+   std::string to_trace_arg(asset value) { return value.to_string(); }
+   std::string to_trace_arg(double value) { return indexer::format_double(value); }
+   std::string to_trace_arg(bool value) { return value ? "1" : "0"; }
+   std::string to_trace_arg(uint32_t value) { return std::to_string(value); }
+   std::string to_trace_arg(uint8_t value) { return std::to_string(value); }
+   std::string to_trace_arg(std::string value) {
+      for (auto& c : value) {
+         if (c == '\t' || c == '\n') {
+            c = ' ';
+         }
+      }
+      return value;
+   }
+   std::string to_trace_arg(const std::vector<symbol>& value) {
+      std::string result;
+      for (auto& item : value) {
+         result += (result.empty() ? "" : " ") + item.to_string();
+      }
+      return result;
+   }
+
+   using formatter = std::function<bool(const std::any&, std::vector<std::string>&)>;
+
+   /** Argument types are taken from the contract method signature **/
+   template <typename R, typename... Args>
+   formatter make_formatter(R (zigzag::*)(Args...)) {
+      return [](const std::any& data, std::vector<std::string>& out) {
+         const auto* args = std::any_cast<std::tuple<std::decay_t<Args>...>>(&data);
+         if (args == nullptr) {
+            return false;
+         }
+         std::apply([&](const auto&... values) { (out.push_back(to_trace_arg(values)), ...); }, *args);
+         return true;
+      };
+   }
+
+   const std::map<uint64_t, formatter>& formatters() {
+      static const std::map<uint64_t, formatter> result = {
+         { name("transfer").value, make_formatter(&zigzag::loan) },
+         { name("setparam").value, make_formatter(&zigzag::setparam) },
+         { name("addcollater").value, make_formatter(&zigzag::addcollater) },
+         { name("setcollater").value, make_formatter(&zigzag::setcollater) },
+         { name("delcollater").value, make_formatter(&zigzag::delcollater) },
+         { name("addoracle").value, make_formatter(&zigzag::addoracle) },
+         { name("setoracle").value, make_formatter(&zigzag::setoracle) },
+         { name("deloracle").value, make_formatter(&zigzag::deloracle) },
+         { name("setrate").value, make_formatter(&zigzag::setrate) },
+         { name("setfeed").value, make_formatter(&zigzag::setfeed) },
+         { name("setinterest").value, make_formatter(&zigzag::setinterest) },
+         { name("addinterest").value, make_formatter(&zigzag::addinterest) },
+         { name("liquidate").value, make_formatter(&zigzag::liquidate) },
+         { name("startsettle").value, make_formatter(&zigzag::startsettle) },
+         { name("settle").value, make_formatter(&zigzag::settle) },
+         { name("rebalance").value, make_formatter(&zigzag::rebalance) },
+         { name("reindex").value, make_formatter(&zigzag::reindex) },
+         { name("migrate").value, make_formatter(&zigzag::migrate) },
+      };
+      return result;
+   }
+
+   /** Book must have exactly the contract positions, totals must be their sums **/
+   template <typename Book>
+   void check_book(uint64_t step, const Book& book) {
+      uint64_t count = 0;
+      indexer::collateral_totals expected;
+      zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+         count++;
+         expected.amount_collateral += position.amount_collateral.amount;
+         expected.amount_borrowed += position.amount_borrowed.amount;
+         expected.amount_interest += position.amount_interest.amount;
+
+         const auto* indexed = book.find_position(position.account, EOS_SYMBOL.code());
+         if (indexed == nullptr) {
+            fail(step, "position of " + position.account.to_string() + " is not indexed");
+            return;
+         }
+         if (indexed->amount_collateral != position.amount_collateral
+            || indexed->amount_borrowed != position.amount_borrowed
+            || indexed->amount_interest != position.amount_interest
+            || indexed->interest_rate != position.interest_rate
+            || indexed->next_interest != position.next_interest) {
+            fail(step, "indexed position of " + position.account.to_string() + " differs from the contract");
+         }
+         if (book.get_debt(position.account) != position.amount_borrowed + position.amount_interest) {
+            fail(step, "indexed debt of " + position.account.to_string() + " differs from the contract");
+         }
+      });
+
+      auto totals = book.get_totals(EOS_SYMBOL.code());
+      if (totals.positions != count
+         || totals.amount_collateral != expected.amount_collateral
+         || totals.amount_borrowed != expected.amount_borrowed
+         || totals.amount_interest != expected.amount_interest) {
+         fail(step, "indexed totals differ from the contract");
+      }
+   }
+
+   /** Book keeps the contract liquidation order rows, stale and orphaned ones too, setrate liquidates in their order **/
+   void check_orders(uint64_t step, const indexer::book& book) {
+      std::map<uint64_t, double> expected;
+      zigzag_native::order_index orders(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+      for (auto itr = orders.begin(); itr != orders.end(); itr++) {
+         expected[itr->account.value] = itr->ratio;
+      }
+      auto itr = book.collaterals().find(EOS_SYMBOL.code().raw());
+      if (expected != (itr == book.collaterals().end() ? std::map<uint64_t, double>() : itr->second.orders)) {
+         fail(step, "indexed liquidation orders differ from the contract");
+      }
+   }
+
+   /** Snapshot queries read the same numbers as the book, but from mapped records **/
+   struct snapshot_book {
+      const indexer::snapshot& mapped;
+
+      const indexer::position* find_position(name user, symbol_code collateral) const {
+         const auto* record = mapped.find_position(user, collateral);
+         if (record == nullptr) {
+            return nullptr;
+         }
+         _position.amount_collateral = asset(record->amount_collateral, symbol(record->collateral_symbol));
+         _position.amount_borrowed = asset(record->amount_borrowed, ZIG_SYMBOL);
+         _position.amount_interest = asset(record->amount_interest, ZIG_SYMBOL);
+         _position.interest_rate = record->interest_rate;
+         _position.next_interest = record->next_interest;
+         return &_position;
+      }
+      asset get_debt(name user) const { return mapped.get_debt(user); }
+      indexer::collateral_totals get_totals(symbol_code collateral) const { return mapped.get_totals(collateral); }
+
+      mutable indexer::position _position;
+   };
+}
+
+int main(int argc, char** argv) {
+   const uint64_t steps = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+   const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+   /** Separator, line end and escape characters in arguments are read back as written **/
+   indexer::trace_action escaped{ 1, EOS_TOKEN, name("transfer"), { "alice", ESCAPED_MEMO, "\\t" } };
+   auto line = indexer::format_trace_line(escaped);
+   if (line.find('\n') != std::string::npos || indexer::parse_trace_line(line).args != escaped.args) {
+      fail(0, "trace escaping: " + line);
+   }
+
+   /** Every committed contract action goes to the trace file **/
+   std::ofstream trace(TRACE_PATH, std::ios::binary | std::ios::trunc);
+   auto& chain = host::chain::instance();
+   chain.set_action_observer([&](uint32_t time, const host::action_data& action) {
+      indexer::trace_action traced{ time, action.account, action.action, {} };
+      auto itr = formatters().find(action.action.value);
+      if (itr == formatters().end() || !itr->second(action.data, traced.args)) {
+         fail(0, "can not trace " + action.account.to_string() + "::" + action.action.to_string());
+         return;
+      }
+      trace << indexer::format_trace_line(traced) << '\n';
+      trace.flush();
+   });
+
+   setup_chain();
+   setparam("liquid.limit", "3");
+   std::vector<name> users;
+   for (uint64_t i = 0; i < USERS; i++) {
+      users.push_back(create_user(i, eos(100000), zig(1000)));
+   }
+   const name oracles[] = { name("oracle.1"), name("oracle.2"), name("oracle.3") };
+
+   std::mt19937_64 random(seed);
+   auto uniform = [&](uint64_t from, uint64_t to) {
+      return std::uniform_int_distribution<uint64_t>(from, to)(random);
+   };
+
+   auto book = std::make_unique<indexer::book>(CONTRACT_NAME);
+   auto reader = std::make_unique<indexer::trace_reader>(TRACE_PATH);
+   auto follow = [&](uint64_t step) {
+      indexer::trace_action action;
+      try {
+         while (reader->next(action)) {
+            book->apply(action);
+            book->trace_offset = reader->offset();
+         }
+      } catch (const std::exception& e) {
+         fail(step, std::string("indexer failed: ") + e.what());
+      }
+      check_book(step, *book);
+      check_orders(step, *book);
+   };
+
+   for (uint64_t step = 0; step < steps && failures == 0; step++) {
+      name user = users[uniform(0, USERS - 1)];
+      uint64_t op = uniform(0, 99);
+
+      if (op < 35) {
+         /** Collateral memos are not parsed, any memo goes to the trace **/
+         const std::string memos[] = { "", "top up", ESCAPED_MEMO };
+         asset quantity(uniform(500, 200000), EOS_SYMBOL);
+         try_transfer(EOS_TOKEN, user, CONTRACT_NAME, quantity, memos[uniform(0, 2)]);
+      } else if (op < 60) {
+         auto balance = chain.get_balance(ZIGZAG_NAME, user, ZIG_SYMBOL);
+         if (balance.amount > 0) {
+            asset quantity(uniform(1, balance.amount), ZIG_SYMBOL);
+            const std::string memos[] = { "", "EOS", repay_memo(EOS_SYMBOL, asset(uniform(1, quantity.amount), ZIG_SYMBOL)) };
+            try_transfer(ZIGZAG_NAME, user, CONTRACT_NAME, quantity, memos[uniform(0, 2)]);
+         }
+      } else if (op < 71) {
+         chain.try_push(CONTRACT_NAME, name("setrate"), oracles[uniform(0, 2)], oracles[uniform(0, 2)], EOS_SYMBOL, double(uniform(10, 100)) / 10);
+      } else if (op < 72) {
+         /**
+          * Liquidations on setrate are switched on and off, the step is checked against the last check rate
+          * Order rows missed while off are added by reindex, often only part of them
+          **/
+         const char* steps[] = { "", "0.05", "0.2" };
+         setparam("liquid.step", steps[uniform(0, 2)]);
+         if (uniform(0, 1)) {
+            chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, users[uniform(0, USERS - 1)], uint32_t(uniform(1, USERS)));
+            chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, name(), uint32_t(uniform(1, USERS)));
+         }
+      } else if (op < 75) {
+         chain.try_push(CONTRACT_NAME, name("setinterest"), name("actor.managr"), user, EOS_SYMBOL, double(uniform(0, 50)) / 10000);
+      } else if (op < 85) {
+         chain.advance_time(uniform(0, 2 * 86400));
+      } else if (op < 92) {
+         chain.try_push(CONTRACT_NAME, name("liquidate"), CRON_NAME, user, EOS_SYMBOL);
+      } else {
+         chain.try_push(CONTRACT_NAME, name("rebalance"), user, user, EOS_SYMBOL, uniform(0, 1) ? 0 : double(uniform(15, 40)) / 10);
+      }
+
+      if (step % BATCH == BATCH - 1) {
+         follow(step);
+      }
+
+      /** Restart indexer from a snapshot, both the mapped snapshot and the loaded book must match **/
+      if (step == steps / 2) {
+         follow(step);
+         indexer::snapshot::write(*book, SNAPSHOT_PATH);
+         indexer::snapshot mapped(SNAPSHOT_PATH);
+         check_book(step, snapshot_book{ mapped });
+         book = std::make_unique<indexer::book>(mapped.load());
+         reader = std::make_unique<indexer::trace_reader>(TRACE_PATH, book->trace_offset);
+         check_book(step, *book);
+         check_orders(step, *book);
+      }
+   }
+
+   /** Global settlement closes the rest in batches **/
+   chain.push(CONTRACT_NAME, name("startsettle"), CONTRACT_NAME, EOS_SYMBOL, 5.);
+   follow(steps);
+   while (failures == 0 && book->get_totals(EOS_SYMBOL.code()).positions > 0) {
+      chain.push(CONTRACT_NAME, name("settle"), CRON_NAME, EOS_SYMBOL, uint32_t(7));
+      follow(steps);
+
+      /** Scheduled interest runs between batches and adds nothing **/
+      auto contract_interest = [&]() {
+         int64_t amount = 0;
+         zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+            amount += position.amount_interest.amount;
+         });
+         return amount;
+      };
+      int64_t amount_interest = contract_interest();
+      chain.advance_time(2 * 86400);
+      follow(steps);
+      if (contract_interest() != amount_interest) {
+         fail(steps, "interest added in global settlement");
+      }
+   }
+
+   std::printf("%llu steps, %llu trace bytes, seed %llu\n",
+      (unsigned long long)steps, (unsigned long long)book->trace_offset, (unsigned long long)seed);
+   std::remove(TRACE_PATH);
+   std::remove(SNAPSHOT_PATH);
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
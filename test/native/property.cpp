@@ -0,0 +1,275 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "fixture.hpp"
+
+/**
+ * Random action sequences against the contract with invariant checks after every step
+ *
+ * Usage: zigzag_property [steps] [seed] [--setrate-liquidations]
+ *
+ * Default run keeps liquid.step and liquid.limit unset, as deployed contracts have them. With --setrate-liquidations
+ * they are set and every setrate is checked to liquidate only due positions, lowest ratio first and within the limit
+ **/
+
+namespace {
+
+   const uint64_t USERS = 50;
+   const double LIQUIDATION_THRESHOLD = 1.4;
+   const uint64_t SETRATE_LIMIT = 3;
+
+   int failures = 0;
+
+   void fail(uint64_t step, const std::string& message) {
+      std::fprintf(stderr, "step %llu: %s\n", (unsigned long long)step, message.c_str());
+      failures++;
+   }
+
+   /** Collateral held by the contract is exactly the sum of position collaterals **/
+   void check_collateral(uint64_t step) {
+      int64_t total = 0;
+      zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+         total += position.amount_collateral.amount;
+      });
+      auto balance = host::chain::instance().get_balance(EOS_TOKEN, CONTRACT_NAME, EOS_SYMBOL);
+      if (balance.amount != total) {
+         fail(step, "contract collateral " + balance.to_string() + " does not match positions " + asset(total, EOS_SYMBOL).to_string());
+      }
+   }
+
+   /** Position amounts are never negative and have expected symbols **/
+   void check_positions(uint64_t step) {
+      zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+         if (position.amount_collateral.symbol != EOS_SYMBOL
+            || position.amount_borrowed.symbol != ZIG_SYMBOL
+            || position.amount_interest.symbol != ZIG_SYMBOL) {
+            fail(step, "position of " + position.account.to_string() + " has wrong symbols");
+         }
+         if (position.amount_collateral.amount <= 0 || position.amount_borrowed.amount < 0 || position.amount_interest.amount < 0) {
+            fail(step, "position of " + position.account.to_string() + " has negative amounts");
+         }
+      });
+   }
+
+   /** Every open position has exactly one scheduled interest transaction **/
+   void check_deferred(uint64_t step) {
+      size_t count = 0;
+      auto& chain = host::chain::instance();
+      zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+         count++;
+         if (chain.find_deferred(CONTRACT_NAME, zigzag_native::get_deferred_tx_id(position.account, EOS_SYMBOL)) == nullptr) {
+            fail(step, "position of " + position.account.to_string() + " has no interest scheduled");
+         }
+      });
+      if (chain.deferred_count() != count) {
+         fail(step, "deferred transactions left for closed positions");
+      }
+   }
+
+   double liquidation_order(const zigzag_native::position_item& position) {
+      return get_liquidation_order(position.amount_collateral, position.amount_borrowed + position.amount_interest);
+   }
+
+   /**
+    * With liquidations on setrate every open position has a liquidation order row with its ratio, closed ones have none
+    * Without them no order rows are written
+    **/
+   void check_orders(uint64_t step, bool is_mode_on) {
+      size_t count = 0;
+      zigzag_native::order_index orders(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+      zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+         if (!is_mode_on) {
+            return;
+         }
+         count++;
+         auto itr = orders.find(position.account.value);
+         if (itr == orders.end() || itr->ratio != liquidation_order(position)) {
+            fail(step, "position of " + position.account.to_string() + " has no liquidation order or a stale one");
+         }
+      });
+      size_t orders_count = 0;
+      for (auto itr = orders.begin(); itr != orders.end(); itr++) {
+         orders_count++;
+      }
+      if (orders_count != count) {
+         fail(step, is_mode_on ? "liquidation orders left for closed positions" : "liquidation orders written with liquidations on setrate off");
+      }
+   }
+
+   /** Collateral is released only down to the target ratio, up to rounding of the converted amount **/
+   void check_rebalanced(uint64_t step, name user, double target_ratio, asset amount_collateral_before) {
+      auto position = zigzag_native::find_position(user, EOS_SYMBOL);
+      if (!position || position->amount_collateral == amount_collateral_before) {
+         return;
+      }
+      asset amount_loan = position->amount_borrowed + position->amount_interest;
+      asset amount_collateral_in_zig = convert_asset(position->amount_collateral, ZIG_SYMBOL, zigzag_native::get_average_rate(EOS_SYMBOL));
+      amount_collateral_in_zig.amount += 1;
+      if (amount_loan.amount > 0 && get_collateral_ratio(amount_collateral_in_zig, amount_loan) < target_ratio) {
+         fail(step, "position of " + user.to_string() + " rebalanced below target ratio");
+      }
+   }
+
+   /** Positions closed by setrate were due for liquidation, within the limit and not healthier than the ones left open **/
+   void check_setrate_liquidations(uint64_t step, const std::vector<zigzag_native::position_item>& before) {
+      double rate = zigzag_native::get_average_rate(EOS_SYMBOL);
+      uint64_t closed = 0;
+      double highest_closed = -HUGE_VAL, lowest_open = HUGE_VAL;
+      for (auto& position : before) {
+         if (zigzag_native::find_position(position.account, EOS_SYMBOL)) {
+            lowest_open = std::min(lowest_open, liquidation_order(position));
+            continue;
+         }
+         closed++;
+         highest_closed = std::max(highest_closed, liquidation_order(position));
+         asset amount_collateral_in_zig = convert_asset(position.amount_collateral, ZIG_SYMBOL, rate);
+         if (get_collateral_ratio(amount_collateral_in_zig, position.amount_borrowed + position.amount_interest) > LIQUIDATION_THRESHOLD) {
+            fail(step, "healthy position of " + position.account.to_string() + " liquidated by setrate");
+         }
+      }
+      if (closed > SETRATE_LIMIT) {
+         fail(step, std::to_string(closed) + " positions liquidated by setrate");
+      }
+      if (highest_closed > lowest_open) {
+         fail(step, "setrate liquidated positions out of ratio order");
+      }
+   }
+
+   /** Token supply is not changed by the contract **/
+   void check_supply(uint64_t step, asset eos_supply, asset zig_supply) {
+      auto& chain = host::chain::instance();
+      if (chain.get_supply(EOS_TOKEN, EOS_SYMBOL) != eos_supply || chain.get_supply(ZIGZAG_NAME, ZIG_SYMBOL) != zig_supply) {
+         fail(step, "token supply changed");
+      }
+   }
+}
+
+int main(int argc, char** argv) {
+   bool setrate_liquidations = false;
+   std::vector<const char*> args;
+   for (int i = 1; i < argc; i++) {
+      if (std::string(argv[i]) == "--setrate-liquidations") {
+         setrate_liquidations = true;
+      } else {
+         args.push_back(argv[i]);
+      }
+   }
+   const uint64_t steps = args.size() > 0 ? std::strtoull(args[0], nullptr, 10) : 100000;
+   const uint64_t seed = args.size() > 1 ? std::strtoull(args[1], nullptr, 10) : 1;
+
+   setup_chain();
+   if (setrate_liquidations) {
+      setparam("liquid.step", "0.05");
+      setparam("liquid.limit", std::to_string(SETRATE_LIMIT));
+   }
+   auto& chain = host::chain::instance();
+
+   std::vector<name> users;
+   for (uint64_t i = 0; i < USERS; i++) {
+      users.push_back(create_user(i, eos(100000), zig(1000)));
+   }
+   const name oracles[] = { name("oracle.1"), name("oracle.2"), name("oracle.3") };
+   const asset eos_supply = chain.get_supply(EOS_TOKEN, EOS_SYMBOL);
+   const asset zig_supply = chain.get_supply(ZIGZAG_NAME, ZIG_SYMBOL);
+
+   std::mt19937_64 random(seed);
+   auto uniform = [&](uint64_t from, uint64_t to) {
+      return std::uniform_int_distribution<uint64_t>(from, to)(random);
+   };
+
+   uint64_t succeeded = 0;
+   for (uint64_t step = 0; step < steps && failures == 0; step++) {
+      name user = users[uniform(0, USERS - 1)];
+      uint64_t op = uniform(0, 99);
+      bool ok = false;
+
+      if (op < 35) {
+         /** Add collateral, opening or topping up the position **/
+         ok = try_transfer(EOS_TOKEN, user, CONTRACT_NAME, asset(uniform(500, 200000), EOS_SYMBOL));
+      } else if (op < 60) {
+         /** Repay with up to the whole ZIG balance, without memo, with collateral or with an amount for it **/
+         auto balance = chain.get_balance(ZIGZAG_NAME, user, ZIG_SYMBOL);
+         if (balance.amount > 0) {
+            asset quantity(uniform(1, balance.amount), ZIG_SYMBOL);
+            const std::string memos[] = { "", "EOS", repay_memo(EOS_SYMBOL, asset(uniform(1, quantity.amount), ZIG_SYMBOL)) };
+            ok = try_transfer(ZIGZAG_NAME, user, CONTRACT_NAME, quantity, memos[uniform(0, 2)]);
+         }
+      } else if (op < 75) {
+         /** With liquidations on setrate, rate moves past liquid.step liquidate the worst positions right away **/
+         std::vector<zigzag_native::position_item> before;
+         zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+            before.push_back(position);
+         });
+         ok = chain.try_push(CONTRACT_NAME, name("setrate"), oracles[uniform(0, 2)], oracles[uniform(0, 2)], EOS_SYMBOL, double(uniform(10, 100)) / 10);
+         if (ok && setrate_liquidations) {
+            check_setrate_liquidations(step, before);
+         }
+      } else if (op < 85) {
+         /** Scheduled interest must never fail **/
+         auto failed = chain.failed_deferred();
+         chain.advance_time(uniform(0, 2 * 86400));
+         if (chain.failed_deferred() != failed) {
+            fail(step, "deferred transaction failed: " + chain.last_error());
+         }
+         ok = true;
+      } else if (op < 92) {
+         ok = chain.try_push(CONTRACT_NAME, name("liquidate"), CRON_NAME, user, EOS_SYMBOL);
+      } else {
+         /** Borrow up to position.def or release collateral down to a random ratio **/
+         double target_ratio = uniform(0, 1) ? 0 : double(uniform(15, 40)) / 10;
+         auto before = zigzag_native::find_position(user, EOS_SYMBOL);
+         ok = chain.try_push(CONTRACT_NAME, name("rebalance"), user, user, EOS_SYMBOL, target_ratio);
+         if (ok) {
+            check_rebalanced(step, user, target_ratio, before->amount_collateral);
+         }
+      }
+      succeeded += ok;
+
+      check_collateral(step);
+      check_positions(step);
+      check_deferred(step);
+      check_orders(step, setrate_liquidations);
+      check_supply(step, eos_supply, zig_supply);
+   }
+
+   /** Final book totals, same seed must give the same numbers between contract builds **/
+   uint64_t count = 0;
+   asset collateral(0, EOS_SYMBOL), borrowed(0, ZIG_SYMBOL), interest(0, ZIG_SYMBOL);
+   zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+      count++;
+      collateral += position.amount_collateral;
+      borrowed += position.amount_borrowed;
+      interest += position.amount_interest;
+   });
+
+   std::printf("%llu steps, %llu succeeded, %llu actions executed, seed %llu\n",
+      (unsigned long long)steps, (unsigned long long)succeeded,
+      (unsigned long long)chain.executed_actions(), (unsigned long long)seed);
+   std::printf("%llu positions, %s collateral, %s borrowed, %s interest\n", (unsigned long long)count,
+      collateral.to_string().c_str(), borrowed.to_string().c_str(), interest.to_string().c_str());
+
+   /** Extreme target ratios need more collateral than any position holds, rebalance keeps all of it **/
+   std::vector<zigzag_native::position_item> open_positions;
+   zigzag_native::for_each_position(EOS_SYMBOL, [&](const auto& position) {
+      open_positions.push_back(position);
+   });
+   for (auto& position : open_positions) {
+      if ((position.amount_borrowed + position.amount_interest).amount == 0) {
+         continue;
+      }
+      for (double target_ratio : { 1e30, 1e300, DBL_MAX }) {
+         if (!chain.try_push(CONTRACT_NAME, name("rebalance"), position.account, position.account, EOS_SYMBOL, target_ratio)) {
+            fail(steps, "rebalance of " + position.account.to_string() + " at extreme ratio: " + chain.last_error());
+         }
+         auto after = zigzag_native::find_position(position.account, EOS_SYMBOL);
+         if (!after || after->amount_collateral != position.amount_collateral) {
+            fail(steps, "collateral of " + position.account.to_string() + " released at extreme ratio");
+         }
+      }
+   }
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
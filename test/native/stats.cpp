@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "fixture.hpp"
+
+/**
+ * Hot path counters of the instrumented build (ZIGZAG_STATS)
+ *
+ * Usage: zigzag_stats_test
+ **/
+
+namespace {
+
+   int failures = 0;
+
+   void expect(bool condition, const std::string& message) {
+      if (!condition) {
+         std::fprintf(stderr, "%s\n", message.c_str());
+         failures++;
+      }
+   }
+
+   /** Counters added to the row by the code, compared with the row before it ran **/
+   template <typename Fn>
+   zigzag_native::stat_item delta(uint64_t scope, name action, Fn&& fn) {
+      auto before = zigzag_native::get_stat(scope, action);
+      fn();
+      auto after = zigzag_native::get_stat(scope, action);
+      return {
+         action,
+         after.calls - before.calls,
+         after.early_exits - before.early_exits,
+         after.rows_scanned - before.rows_scanned,
+         after.inline_actions - before.inline_actions
+      };
+   }
+
+   std::string describe(const zigzag_native::stat_item& stat) {
+      return stat.action.to_string() + ": " + std::to_string(stat.calls) + " calls, "
+         + std::to_string(stat.early_exits) + " early exits, " + std::to_string(stat.rows_scanned) + " rows, "
+         + std::to_string(stat.inline_actions) + " inline actions";
+   }
+}
+
+int main() {
+   setup_chain();
+   auto& chain = host::chain::instance();
+   const uint64_t self = CONTRACT_NAME.value;
+   const uint64_t eos_scope = EOS_SYMBOL.code().raw();
+   name user = create_user(0, eos(100), zig(100));
+
+   /** Transfer of a token which is not a collateral is counted in the contract scope, no row in the token scope **/
+   const symbol foo_symbol = symbol("FOO", 4);
+   const name foo_token = name("foo.token");
+   chain.create_token(foo_token, asset(1000000000, foo_symbol));
+   chain.issue(foo_token, user, asset(100000, foo_symbol));
+   auto foo = delta(self, name("loan"), [&]() {
+      transfer(foo_token, user, CONTRACT_NAME, asset(100000, foo_symbol));
+   });
+   expect(foo.calls == 1 && foo.early_exits == 1, "foreign token " + describe(foo));
+   expect(!zigzag_native::has_stats(foo_symbol.code().raw()), "stats row created in foreign token scope");
+
+   /** New position: rates of two oracles are read, ZIG and deferred interest are sent **/
+   auto outgoing = zigzag_native::get_stat(self, name("transferzig"));
+   auto open = delta(eos_scope, name("loan"), [&]() {
+      transfer(EOS_TOKEN, user, CONTRACT_NAME, eos(10));
+   });
+   expect(open.calls == 1 && open.early_exits == 0 && open.rows_scanned == 2 && open.inline_actions == 2, "loan " + describe(open));
+
+   /** Contract own ZIG transfer notification returns right away **/
+   auto notified = zigzag_native::get_stat(self, name("transferzig"));
+   expect(notified.calls == outgoing.calls + 1 && notified.early_exits == outgoing.early_exits + 1, "outgoing " + describe(notified));
+
+   /** Healthy position is not liquidated **/
+   auto healthy = delta(eos_scope, name("liquidate"), [&]() {
+      chain.push(CONTRACT_NAME, name("liquidate"), CRON_NAME, user, EOS_SYMBOL);
+   });
+   expect(healthy.calls == 1 && healthy.early_exits == 1 && healthy.inline_actions == 0, "liquidate " + describe(healthy));
+
+   /** Counters of a failed action are rolled back with it **/
+   auto failed = delta(eos_scope, name("liquidate"), [&]() {
+      chain.try_push(CONTRACT_NAME, name("liquidate"), CRON_NAME, name("nobody"), EOS_SYMBOL);
+   });
+   expect(failed.calls == 0, "failed liquidate " + describe(failed));
+
+   std::printf("%s\n", failures == 0 ? "stats counters ok" : "stats counters failed");
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
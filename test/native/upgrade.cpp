@@ -0,0 +1,232 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "fixture.hpp"
+
+/**
+ * Upgrade of tables written by earlier contract versions
+ *
+ * Rows written before a field was added are rows with the binary extension left empty, legacy oracles
+ * rows keep symbol lists and positions have no liquidation order rows. Contract must keep working on them,
+ * migrate and reindex must bring them to the current layout
+ *
+ * Usage: zigzag_upgrade_test
+ **/
+
+namespace {
+
+   const symbol BOS_SYMBOL = symbol("BOS", 4);
+   const name BOS_TOKEN = name("bos.token");
+   const symbol FOO_SYMBOL = symbol("FOO", 4);
+
+   int failures = 0;
+
+   void expect(bool condition, const std::string& message) {
+      if (!condition) {
+         std::fprintf(stderr, "%s\n", message.c_str());
+         failures++;
+      }
+   }
+
+   void expect_error(bool ok, const std::string& error, const std::string& message) {
+      auto& chain = host::chain::instance();
+      expect(!ok && chain.last_error().find(error) == 0, message + ": " + (ok ? "succeeded" : chain.last_error()));
+   }
+
+   zigzag_native::collateral_item get_collateral(symbol collateral) {
+      zigzag_native::collateral_index collaterals(CONTRACT_NAME, CONTRACT_NAME.value);
+      return collaterals.get(collateral.code().raw());
+   }
+
+   uint64_t get_oracle_mask(name oracle) {
+      zigzag_native::oracle_index oracles(CONTRACT_NAME, CONTRACT_NAME.value);
+      auto itr = oracles.find(oracle.value);
+      return itr == oracles.end() ? 0 : itr->collaterals;
+   }
+
+   uint64_t bit(symbol collateral) {
+      return 1ULL << *get_collateral(collateral).id;
+   }
+
+   bool has_order(name user) {
+      zigzag_native::order_index orders(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+      return orders.find(user.value) != orders.end();
+   }
+
+   bool is_migrated(symbol collateral) {
+      auto item = get_collateral(collateral);
+      return item.id.has_value() && item.settlement_rate.has_value() && item.check_rate.has_value();
+   }
+
+   /**
+    * Contract state as left by the version before collateral ids: EOS and BOS collaterals, oracles with symbol lists
+    * and EOS positions of the users without liquidation order rows, 10.0000 EOS collateral each
+    **/
+   void setup_legacy_chain(const std::vector<std::pair<name, asset>>& positions) {
+      auto& chain = host::chain::instance();
+      chain.reset();
+
+      chain.set_contract(CONTRACT_NAME);
+      for (auto account : { "actor.managr", "actor.cron", "liquid.addr", "oracle.1", "oracle.2", "oracle.3" }) {
+         chain.create_account(name(account));
+      }
+      chain.create_token(EOS_TOKEN, asset(10000000000000LL, EOS_SYMBOL));
+      chain.create_token(BOS_TOKEN, asset(10000000000000LL, BOS_SYMBOL));
+      chain.create_token(ZIGZAG_NAME, asset(10000000000000LL, ZIG_SYMBOL));
+      chain.issue(ZIGZAG_NAME, CONTRACT_NAME, zig(100000000));
+      chain.issue(EOS_TOKEN, CONTRACT_NAME, eos(10 * positions.size()));
+
+      setparam("max.oracles", "10");
+      setparam("position.def", "1.5");
+      setparam("interest.def", "0.001");
+      setparam("interest.int", "86400");
+      setparam("liquidate.th", "1.4");
+      setparam("penalty", "0.15");
+      setparam("manager", "actor.managr");
+      setparam("cron.account", "actor.cron");
+      setparam("liquid.addr", "liquid.addr");
+
+      chain.run(CONTRACT_NAME, {}, [&]() {
+         zigzag_native::collateral_index collaterals(CONTRACT_NAME, CONTRACT_NAME.value);
+         collaterals.emplace(CONTRACT_NAME, [&](auto& row) {
+            row.symbol = EOS_SYMBOL;
+            row.account = EOS_TOKEN;
+            row.is_active = true;
+         });
+         collaterals.emplace(CONTRACT_NAME, [&](auto& row) {
+            row.symbol = BOS_SYMBOL;
+            row.account = BOS_TOKEN;
+            row.is_active = false;
+         });
+
+         /** FOO collateral was deleted, legacy delcollater left it in the oracle symbols **/
+         zigzag_native::legacy_oracle_index oracles(CONTRACT_NAME, CONTRACT_NAME.value);
+         const std::pair<const char*, std::vector<symbol>> legacy[] = {
+            { "oracle.1", { EOS_SYMBOL, BOS_SYMBOL } },
+            { "oracle.2", { EOS_SYMBOL } },
+            { "oracle.3", { EOS_SYMBOL, FOO_SYMBOL } },
+         };
+         for (auto& [account, symbols] : legacy) {
+            oracles.emplace(CONTRACT_NAME, [&](auto& row) {
+               row.account = name(account);
+               row.symbols = symbols;
+            });
+         }
+
+         zigzag_native::position_index position_table(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+         for (auto& [user, borrowed] : positions) {
+            position_table.emplace(CONTRACT_NAME, [&](auto& row) {
+               row.account = user;
+               row.amount_collateral = eos(10);
+               row.amount_borrowed = borrowed;
+               row.amount_interest = zig(0);
+               row.interest_rate = 0.001;
+               row.next_interest = current_time_point().sec_since_epoch() + 86400;
+            });
+         }
+
+         zigzag_native::rate_index rates(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+         for (auto [account, rate] : { std::make_pair("oracle.2", 4.), std::make_pair("oracle.3", 8.) }) {
+            rates.emplace(CONTRACT_NAME, [&](auto& row) {
+               row.account = name(account);
+               row.rate_to_usd = rate;
+            });
+         }
+      });
+   }
+}
+
+int main() {
+   auto& chain = host::chain::instance();
+   name alice = user_name(0), bob = user_name(1), carol = user_name(2), dave = user_name(3);
+
+   /** At the average rate of 6 USD/EOS Bob and Dave are due for liquidation, Carol is healthy **/
+   setup_legacy_chain({ { bob, zig(50) }, { carol, zig(30) }, { dave, zig(50) } });
+   for (uint64_t i = 0; i < 4; i++) {
+      create_user(i, eos(100), zig(100));
+   }
+
+   /** Loans and repayments do not write collateral rows, they work before migrate **/
+   transfer(EOS_TOKEN, alice, CONTRACT_NAME, eos(10));
+   expect(zigzag_native::find_position(alice, EOS_SYMBOL).has_value(), "loan before migrate");
+   transfer(ZIGZAG_NAME, alice, CONTRACT_NAME, zig(1));
+   expect(!is_migrated(EOS_SYMBOL), "legacy collateral row written by loan or repayment");
+   expect(!has_order(alice), "order row written with liquidations on setrate off");
+
+   /** Actions which need ids or write extensions after them ask for migrate **/
+   expect_error(chain.try_push(CONTRACT_NAME, name("startsettle"), CONTRACT_NAME, EOS_SYMBOL, 5.), "ZZ103", "startsettle before migrate");
+   expect_error(chain.try_push(CONTRACT_NAME, name("addoracle"), CONTRACT_NAME, name("actor.managr"), std::vector<symbol>{ EOS_SYMBOL }), "ZZ103", "addoracle before migrate");
+   expect(!chain.try_push(CONTRACT_NAME, name("setrate"), name("oracle.1"), name("oracle.1"), EOS_SYMBOL, 6.), "setrate before migrate");
+
+   /** Ids are assigned, extensions filled, oracles moved to bitmasks without the deleted collateral **/
+   chain.push(CONTRACT_NAME, name("migrate"), CONTRACT_NAME);
+   expect(is_migrated(EOS_SYMBOL) && is_migrated(BOS_SYMBOL), "collaterals migrated");
+   expect(*get_collateral(EOS_SYMBOL).id != *get_collateral(BOS_SYMBOL).id, "collateral ids are unique");
+   expect(get_collateral(EOS_SYMBOL).settlement_rate.value() == 0 && get_collateral(EOS_SYMBOL).check_rate.value() == 0, "migrated collateral is not settling");
+   expect(get_oracle_mask(name("oracle.1")) == (bit(EOS_SYMBOL) | bit(BOS_SYMBOL)), "oracle.1 collaterals");
+   expect(get_oracle_mask(name("oracle.2")) == bit(EOS_SYMBOL), "oracle.2 collaterals");
+   expect(get_oracle_mask(name("oracle.3")) == bit(EOS_SYMBOL), "oracle.3 collaterals");
+   zigzag_native::legacy_oracle_index legacy_oracles(CONTRACT_NAME, CONTRACT_NAME.value);
+   expect(legacy_oracles.begin() == legacy_oracles.end(), "legacy oracles left");
+
+   /** Second run changes nothing **/
+   auto eos_id = *get_collateral(EOS_SYMBOL).id;
+   chain.push(CONTRACT_NAME, name("migrate"), CONTRACT_NAME);
+   expect(*get_collateral(EOS_SYMBOL).id == eos_id && get_oracle_mask(name("oracle.3")) == bit(EOS_SYMBOL), "second migrate");
+
+   /** Migrated tables work as new ones **/
+   expect(chain.try_push(CONTRACT_NAME, name("setrate"), name("oracle.1"), name("oracle.1"), EOS_SYMBOL, 6.), "setrate after migrate: " + chain.last_error());
+   expect(chain.try_push(CONTRACT_NAME, name("addcollater"), CONTRACT_NAME, symbol("ZIG", 4), ZIGZAG_NAME), "addcollater after migrate: " + chain.last_error());
+   expect(*get_collateral(symbol("ZIG", 4)).id != eos_id && *get_collateral(symbol("ZIG", 4)).id != *get_collateral(BOS_SYMBOL).id, "new collateral id is free");
+   expect(chain.try_push(CONTRACT_NAME, name("startsettle"), CONTRACT_NAME, BOS_SYMBOL, 2.), "startsettle after migrate: " + chain.last_error());
+
+   /** Positions without order rows are not seen by setrate, the keeper and the owner can still close and change them **/
+   setparam("liquid.step", "0.05");
+   setparam("liquid.limit", "5");
+   setrate(name("oracle.1"), EOS_SYMBOL, 6);
+   expect(zigzag_native::find_position(bob, EOS_SYMBOL).has_value(), "position without order row liquidated by setrate");
+   expect(chain.try_push(CONTRACT_NAME, name("liquidate"), CRON_NAME, dave, EOS_SYMBOL), "liquidate without order row: " + chain.last_error());
+   expect(!zigzag_native::find_position(dave, EOS_SYMBOL).has_value(), "position without order row not liquidated by keeper");
+   transfer(ZIGZAG_NAME, carol, CONTRACT_NAME, zig(1));
+   expect(has_order(carol), "repaid position has no order row");
+
+   /** Reindex adds the rest, next rate move liquidates Bob **/
+   expect(!has_order(bob), "order row before reindex");
+   chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, name(), uint32_t(1));
+   chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, alice, uint32_t(10));
+   expect(has_order(bob), "no order row after reindex");
+   setrate(name("oracle.1"), EOS_SYMBOL, 4.5);
+   expect(!zigzag_native::find_position(bob, EOS_SYMBOL).has_value(), "reindexed position not liquidated by setrate");
+   expect(!has_order(bob), "order row left for liquidated position");
+
+   /** Order rows without a position do not stop setrate, reindex drops them too **/
+   auto add_orphan_order = [&](name user) {
+      chain.run(CONTRACT_NAME, {}, [&]() {
+         zigzag_native::order_index orders(CONTRACT_NAME, EOS_SYMBOL.code().raw());
+         orders.emplace(CONTRACT_NAME, [&](auto& row) {
+            row.account = user;
+            row.ratio = 0;
+         });
+      });
+   };
+   add_orphan_order(bob);
+   expect(chain.try_push(CONTRACT_NAME, name("setrate"), name("oracle.1"), name("oracle.1"), EOS_SYMBOL, 5.5), "setrate with orphan order row: " + chain.last_error());
+   expect(!has_order(bob), "orphan order row left by setrate");
+   expect(zigzag_native::find_position(carol, EOS_SYMBOL).has_value() && has_order(carol), "healthy position liquidated after orphan order row");
+   add_orphan_order(bob);
+   add_orphan_order(dave);
+   chain.push(CONTRACT_NAME, name("reindex"), CRON_NAME, EOS_SYMBOL, name(), uint32_t(10));
+   expect(!has_order(bob) && !has_order(dave), "orphan order rows left by reindex");
+   expect(has_order(alice) && has_order(carol), "order rows dropped by reindex");
+
+   /** Position closed while the mode is off leaves its order row, next setrate drops it **/
+   setparam("liquid.step", "");
+   transfer(ZIGZAG_NAME, alice, CONTRACT_NAME, zig(100));
+   expect(!zigzag_native::find_position(alice, EOS_SYMBOL).has_value() && has_order(alice), "order row of position closed with the mode off");
+   setparam("liquid.step", "0.05");
+   expect(chain.try_push(CONTRACT_NAME, name("setrate"), name("oracle.1"), name("oracle.1"), EOS_SYMBOL, 4.), "setrate with order row of closed position: " + chain.last_error());
+   expect(!has_order(alice), "order row of closed position left by setrate");
+
+   std::printf("%s\n", failures == 0 ? "upgrade passed" : "upgrade failed");
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
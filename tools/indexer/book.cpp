@@ -0,0 +1,492 @@
+#include "book.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "zigzag.common.hpp"
+
+namespace indexer {
+
+   using eosio::asset;
+   using eosio::name;
+   using eosio::symbol;
+   using eosio::symbol_code;
+
+   namespace {
+      void expect_args(const trace_action& action, size_t count) {
+         if (action.args.size() != count) {
+            throw std::runtime_error(action.action.to_string() + " expects " + std::to_string(count) + " arguments");
+         }
+      }
+
+      bool parse_bool(const std::string& str) {
+         return str == "1" || str == "true";
+      }
+
+      /** Book does not match the trace, some actions are missing or were applied twice **/
+      [[noreturn]] void inconsistent(const trace_action& action, const std::string& what) {
+         throw std::runtime_error("trace at " + std::to_string(action.time) + " " + action.action.to_string() + ": " + what);
+      }
+   }
+
+   void book::apply(const trace_action& action) {
+
+      /** Same routing as the contract apply handler **/
+      if (action.action == name("transfer")) {
+         if (action.code == ZIGZAG_NAME) {
+            transferzig(action);
+         } else {
+            loan(action);
+         }
+         return;
+      }
+      if (action.code != _contract) {
+         return;
+      }
+
+      switch (action.action.value) {
+         case name("setparam").value:     setparam(action); break;
+         case name("addcollater").value:  addcollater(action); break;
+         case name("setcollater").value:  setcollater(action); break;
+         case name("delcollater").value:  delcollater(action); break;
+         case name("deloracle").value:    deloracle(action); break;
+         case name("setrate").value:      setrate(action); break;
+         case name("setinterest").value:  setinterest(action); break;
+         case name("addinterest").value:  addinterest(action); break;
+         case name("liquidate").value:    liquidate(action); break;
+         case name("startsettle").value:  startsettle(action); break;
+         case name("settle").value:       settle(action); break;
+         case name("rebalance").value:    rebalance(action); break;
+         case name("reindex").value:      reindex(action); break;
+         case name("setfeed").value:
+            expect_args(action, 7);
+            if (!action.args[1].empty()) {
+               inconsistent(action, "price feed collaterals are not supported");
+            }
+            break;
+         default:
+            /** Oracle membership, permissions and other actions do not change the book **/
+            break;
+      }
+   }
+
+   const position* book::find_position(name user, symbol_code collateral) const {
+      auto collateral_iterator = _collaterals.find(collateral.raw());
+      if (collateral_iterator == _collaterals.end()) {
+         return nullptr;
+      }
+      auto position_iterator = collateral_iterator->second.positions.find(user.value);
+      return position_iterator == collateral_iterator->second.positions.end() ? nullptr : &position_iterator->second;
+   }
+
+   asset book::get_debt(name user) const {
+      asset debt(0, ZIG_SYMBOL);
+      for (auto& [code, item] : _collaterals) {
+         auto position_iterator = item.positions.find(user.value);
+         if (position_iterator != item.positions.end()) {
+            debt += position_iterator->second.amount_borrowed + position_iterator->second.amount_interest;
+         }
+      }
+      return debt;
+   }
+
+   collateral_totals book::get_totals(symbol_code collateral) const {
+      auto collateral_iterator = _collaterals.find(collateral.raw());
+      if (collateral_iterator == _collaterals.end()) {
+         return collateral_totals();
+      }
+      collateral_totals totals = collateral_iterator->second.totals;
+      totals.symbol = collateral_iterator->second.symbol;
+      return totals;
+   }
+
+   void book::setparam(const trace_action& action) {
+      expect_args(action, 2);
+      auto key = name(action.args[0]).value;
+      if (action.args[1].empty()) {
+         _params.erase(key);
+      } else {
+         _params[key] = action.args[1];
+      }
+   }
+
+   void book::addcollater(const trace_action& action) {
+      expect_args(action, 2);
+      symbol sym = parse_symbol(action.args[0]);
+      auto& item = get_collateral(sym.code());
+      item.symbol = sym;
+      item.account = name(action.args[1]);
+      item.exists = true;
+      item.is_active = false;
+      item.settlement_rate = 0;
+      item.check_rate = 0;
+   }
+
+   void book::setcollater(const trace_action& action) {
+      expect_args(action, 2);
+      get_collateral(parse_symbol(action.args[0]).code()).is_active = parse_bool(action.args[1]);
+   }
+
+   void book::delcollater(const trace_action& action) {
+      expect_args(action, 1);
+      get_collateral(parse_symbol(action.args[0]).code()).exists = false;
+   }
+
+   void book::deloracle(const trace_action& action) {
+      expect_args(action, 1);
+      auto oracle = name(action.args[0]).value;
+      for (auto& [code, item] : _collaterals) {
+         if (item.exists) {
+            item.rates.erase(oracle);
+         }
+      }
+   }
+
+   void book::setrate(const trace_action& action) {
+      expect_args(action, 3);
+      auto& item = get_collateral(parse_symbol(action.args[1]).code());
+      item.rates[name(action.args[0]).value] = parse_double(action.args[2]);
+
+      /** Same liquidation check as the contract, when the mode is on and the rate moved by the step **/
+      if (!is_liquidation_mode_on()) {
+         return;
+      }
+      double step = param_to_double(get_optional_param_string(LIQUIDATE_STEP));
+      int limit = std::stoi(get_optional_param_string(LIQUIDATE_LIMIT));
+      double rate = get_average_rate(item);
+      if (item.check_rate > 0 && fabs(rate - item.check_rate) < item.check_rate * step) {
+         return;
+      }
+      item.check_rate = rate;
+
+      /** Order rows in byratio index order of the contract, (ratio, account) **/
+      std::vector<std::pair<double, uint64_t>> order;
+      order.reserve(item.orders.size());
+      for (auto& [account, ratio] : item.orders) {
+         order.emplace_back(ratio, account);
+      }
+      std::sort(order.begin(), order.end());
+
+      double threshold = get_param_double(LIQUIDATE_THRESHOLD);
+      int count = 0;
+      for (size_t i = 0; i < order.size() && count < limit; i++) {
+         auto position_iterator = item.positions.find(order[i].second);
+         if (position_iterator == item.positions.end()) {
+            item.orders.erase(order[i].second);
+            continue;
+         }
+         if (!is_liquidation_due(position_iterator->second, rate, threshold)) {
+            break;
+         }
+         set_position(item, name(order[i].second), std::nullopt);
+         count++;
+      }
+   }
+
+   void book::setinterest(const trace_action& action) {
+      expect_args(action, 3);
+      auto& item = get_collateral(parse_symbol(action.args[1]).code());
+      auto user = name(action.args[0]);
+      auto position_iterator = item.positions.find(user.value);
+      if (position_iterator == item.positions.end()) {
+         inconsistent(action, "position of " + user.to_string() + " not found");
+      }
+      position_iterator->second.interest_rate = parse_double(action.args[2]);
+   }
+
+   void book::addinterest(const trace_action& action) {
+      expect_args(action, 2);
+      auto& item = get_collateral(parse_symbol(action.args[1]).code());
+      auto user = name(action.args[0]);
+      auto position_iterator = item.positions.find(user.value);
+      if (position_iterator == item.positions.end()) {
+         inconsistent(action, "position of " + user.to_string() + " not found");
+      }
+
+      /** Debt of a collateral in global settlement does not grow **/
+      position value = position_iterator->second;
+      if (item.settlement_rate == 0 && accrue_interest(value, action.time)) {
+         set_position(item, user, value);
+      }
+   }
+
+   void book::liquidate(const trace_action& action) {
+      expect_args(action, 2);
+      auto& item = get_collateral(parse_symbol(action.args[1]).code());
+      auto user = name(action.args[0]);
+      auto position_iterator = item.positions.find(user.value);
+      if (position_iterator == item.positions.end()) {
+         inconsistent(action, "position of " + user.to_string() + " not found");
+      }
+
+      /** Healthy position is left as is **/
+      if (!is_liquidation_due(position_iterator->second, get_average_rate(item), get_param_double(LIQUIDATE_THRESHOLD))) {
+         return;
+      }
+      set_position(item, user, std::nullopt);
+   }
+
+   void book::startsettle(const trace_action& action) {
+      expect_args(action, 2);
+      auto& item = get_collateral(parse_symbol(action.args[0]).code());
+      item.is_active = false;
+      item.settlement_rate = parse_double(action.args[1]);
+   }
+
+   void book::settle(const trace_action& action) {
+      expect_args(action, 2);
+      auto& item = get_collateral(parse_symbol(action.args[0]).code());
+      auto limit = parse_uint(action.args[1]);
+
+      /** Same as the contract, settled positions are erased and every batch starts from the first one left **/
+      for (uint64_t count = 0; count < limit && !item.positions.empty(); count++) {
+         set_position(item, item.positions.begin()->second.account, std::nullopt);
+      }
+   }
+
+   void book::rebalance(const trace_action& action) {
+      expect_args(action, 3);
+      auto& item = get_collateral(parse_symbol(action.args[1]).code());
+      auto user = name(action.args[0]);
+      auto position_iterator = item.positions.find(user.value);
+      if (position_iterator == item.positions.end()) {
+         inconsistent(action, "position of " + user.to_string() + " not found");
+      }
+      double target_ratio = parse_double(action.args[2]);
+
+      /** Same steps as the contract rebalance **/
+      position value = position_iterator->second;
+      bool is_changed = item.settlement_rate == 0 && accrue_interest(value, action.time);
+      double rate = get_average_rate(item);
+      asset amount_loan = value.amount_borrowed + value.amount_interest;
+      if (target_ratio == 0) {
+         asset amount_loan_limit = get_loan_limit(value.amount_collateral, rate, get_param_double(POSITION_DEF));
+         if (amount_loan_limit > amount_loan) {
+            value.amount_borrowed += amount_loan_limit - amount_loan;
+            is_changed = true;
+         }
+      } else {
+         asset amount_collateral_required = get_required_collateral(amount_loan, value.amount_collateral, rate, target_ratio);
+         if (amount_collateral_required < value.amount_collateral) {
+            value.amount_collateral = amount_collateral_required;
+            is_changed = true;
+         }
+      }
+
+      /** Unchanged position is not written, neither is its order row **/
+      if (!is_changed) {
+         return;
+      }
+
+      bool is_closed = value.amount_collateral.amount == 0 && amount_loan.amount == 0;
+      set_position(item, user, is_closed ? std::nullopt : std::optional<position>(value));
+   }
+
+   void book::reindex(const trace_action& action) {
+      expect_args(action, 3);
+      auto& item = get_collateral(parse_symbol(action.args[0]).code());
+      auto from = name(action.args[1]);
+      auto limit = parse_uint(action.args[2]);
+
+      /** Same walk as the contract, order rows are written only while the mode is on **/
+      bool is_mode_on = is_liquidation_mode_on();
+      auto position_iterator = item.positions.lower_bound(from.value);
+      for (uint64_t count = 0; count < limit && position_iterator != item.positions.end(); count++, position_iterator++) {
+         if (is_mode_on) {
+            auto& value = position_iterator->second;
+            item.orders[position_iterator->first] = get_liquidation_order(value.amount_collateral, value.amount_borrowed + value.amount_interest);
+         }
+      }
+      bool is_last = position_iterator == item.positions.end();
+      for (auto order_iterator = item.orders.lower_bound(from.value); order_iterator != item.orders.end();) {
+         if (!is_last && order_iterator->first >= position_iterator->first) {
+            break;
+         }
+         if (item.positions.count(order_iterator->first) == 0) {
+            order_iterator = item.orders.erase(order_iterator);
+         } else {
+            order_iterator++;
+         }
+      }
+   }
+
+   void book::transferzig(const trace_action& action) {
+      expect_args(action, 4);
+      auto from = name(action.args[0]);
+      auto to = name(action.args[1]);
+      if (from == _contract || to != _contract || from == ZIGZAG_NAME) {
+         return;
+      }
+      asset quantity = parse_asset(action.args[2]);
+      std::string memo = action.args[3].empty() ? std::string(DEFAULT_COLLATERAL_SYMBOL) : action.args[3];
+      std::vector<repayment_allocation> allocations;
+      if (!parse_repayment_memo(memo, allocations)) {
+         inconsistent(action, "invalid repayment memo " + memo);
+      }
+
+      /** Same steps as the contract, in memo order **/
+      asset remaining = quantity;
+      for (auto& allocation : allocations) {
+         auto& item = get_collateral(allocation.collateral);
+         auto position_iterator = item.positions.find(from.value);
+         if (position_iterator == item.positions.end()) {
+            inconsistent(action, "position of " + from.to_string() + " not found");
+         }
+
+         /** Full repayment closes position, partial one repays interest first **/
+         position value = position_iterator->second;
+         asset loan = value.amount_borrowed + value.amount_interest;
+         asset amount = allocation.amount == 0 ? remaining : asset(allocation.amount, quantity.symbol);
+         if (allocations.size() > 1 && amount.amount == 0) {
+            continue;
+         }
+         if (amount >= loan) {
+            remaining -= loan;
+            set_position(item, from, std::nullopt);
+         } else {
+            remaining -= amount;
+            apply_repayment(value.amount_interest, value.amount_borrowed, amount.amount);
+            set_position(item, from, value);
+         }
+      }
+   }
+
+   void book::loan(const trace_action& action) {
+      expect_args(action, 4);
+      auto from = name(action.args[0]);
+      auto to = name(action.args[1]);
+      if (from == _contract || to != _contract) {
+         return;
+      }
+      asset quantity = parse_asset(action.args[2]);
+
+      /** Transfers of tokens which are not active collaterals are kept by the contract as is **/
+      auto collateral_iterator = _collaterals.find(quantity.symbol.code().raw());
+      if (collateral_iterator == _collaterals.end() || !collateral_iterator->second.exists || !collateral_iterator->second.is_active) {
+         return;
+      }
+      auto& item = collateral_iterator->second;
+
+      double rate = get_average_rate(item);
+      double position_def = get_param_double(POSITION_DEF);
+
+      /** Same steps as the contract loan handler **/
+      auto position_iterator = item.positions.find(from.value);
+      bool existing_position = position_iterator != item.positions.end();
+      position value;
+      if (existing_position) {
+         value = position_iterator->second;
+      } else {
+         value.account = from;
+         value.amount_collateral = asset(0, quantity.symbol);
+         value.amount_borrowed = asset(0, ZIG_SYMBOL);
+         value.amount_interest = asset(0, ZIG_SYMBOL);
+         value.interest_rate = get_param_double(INTEREST_DEF);
+         value.next_interest = action.time;
+      }
+
+      value.amount_collateral += quantity;
+      asset amount_borrowed_change = get_loan_limit(value.amount_collateral, rate, position_def) - (value.amount_borrowed + value.amount_interest);
+      if (amount_borrowed_change.amount > 0) {
+         value.amount_borrowed += amount_borrowed_change;
+      }
+
+      /** First interest of a new position **/
+      if (!existing_position) {
+         value.amount_interest += get_interest(value.amount_borrowed, value.interest_rate, value.amount_interest.symbol);
+         value.next_interest += get_param_int(INTEREST_INT);
+      }
+      set_position(item, from, value);
+   }
+
+   collateral& book::get_collateral(symbol_code code) {
+      return _collaterals[code.raw()];
+   }
+
+   std::string book::get_param_string(name key) const {
+      auto itr = _params.find(key.value);
+      if (itr == _params.end()) {
+         throw std::runtime_error("param " + key.to_string() + " not found");
+      }
+      return itr->second;
+   }
+
+   std::string book::get_optional_param_string(name key) const {
+      auto itr = _params.find(key.value);
+      return itr != _params.end() ? itr->second : std::string();
+   }
+
+   double book::get_param_double(name key) const {
+      return param_to_double(get_param_string(key));
+   }
+
+   int book::get_param_int(name key) const {
+      return std::stoi(get_param_string(key));
+   }
+
+   double book::get_average_rate(const collateral& item) const {
+      if (item.rates.empty()) {
+         throw std::runtime_error("no rates for " + item.symbol.code().to_string());
+      }
+      double rate = 0;
+      for (auto& [oracle, value] : item.rates) {
+         rate += value;
+      }
+      return rate / item.rates.size();
+   }
+
+   /** Same as accrue_interest of the contract **/
+   bool book::accrue_interest(position& value, uint32_t time) const {
+      if (value.next_interest > time) {
+         return false;
+      }
+      value.amount_interest += get_interest(value.amount_borrowed, value.interest_rate, value.amount_interest.symbol);
+      value.next_interest += get_param_int(INTEREST_INT);
+      return true;
+   }
+
+   /** Same as is_liquidation_due of the contract **/
+   bool book::is_liquidation_due(const position& value, double rate, double threshold) const {
+      asset amount_collateral_in_zig = convert_asset(value.amount_collateral, ZIG_SYMBOL, rate);
+      return get_collateral_ratio(amount_collateral_in_zig, value.amount_interest + value.amount_borrowed) <= threshold;
+   }
+
+   /** Same as is_liquidation_mode_on of the contract **/
+   bool book::is_liquidation_mode_on() const {
+      std::string limit_value = get_optional_param_string(LIQUIDATE_LIMIT);
+      return param_to_double(get_optional_param_string(LIQUIDATE_STEP)) > 0 && !limit_value.empty() && std::stoi(limit_value) > 0;
+   }
+
+   void book::set_position(collateral& item, name account, const std::optional<position>& value) {
+      /** Every position write of the contract also writes its order row, while the mode is on **/
+      if (is_liquidation_mode_on()) {
+         if (value) {
+            item.orders[account.value] = get_liquidation_order(value->amount_collateral, value->amount_borrowed + value->amount_interest);
+         } else {
+            item.orders.erase(account.value);
+         }
+      }
+
+      auto& totals = item.totals;
+      auto position_iterator = item.positions.find(account.value);
+      if (position_iterator != item.positions.end()) {
+         totals.positions--;
+         totals.amount_collateral -= position_iterator->second.amount_collateral.amount;
+         totals.amount_borrowed -= position_iterator->second.amount_borrowed.amount;
+         totals.amount_interest -= position_iterator->second.amount_interest.amount;
+      }
+
+      if (!value) {
+         if (position_iterator != item.positions.end()) {
+            item.positions.erase(position_iterator);
+         }
+         return;
+      }
+
+      totals.positions++;
+      totals.amount_collateral += value->amount_collateral.amount;
+      totals.amount_borrowed += value->amount_borrowed.amount;
+      totals.amount_interest += value->amount_interest.amount;
+      item.positions[account.value] = *value;
+   }
+}
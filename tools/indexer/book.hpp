@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <eosio/asset.hpp>
+#include <eosio/name.hpp>
+#include <eosio/symbol.hpp>
+
+#include "trace.hpp"
+
+/**
+ * In-memory position book of the contract, built from the action trace
+ *
+ * Actions are applied with the same math as the contract (src/zigzag.common.hpp) and in the same
+ * table order, so positions match the contract positions table exactly. Only successful actions
+ * are traced, so the book does not repeat contract validation, it only repeats early returns
+ * which leave the tables unchanged.
+ *
+ * Collaterals with price feed rates (setfeed) are not supported, feed datapoints are not traced
+ **/
+namespace indexer {
+
+   /** Same fields as position_item of the contract **/
+   struct position {
+      eosio::name account;
+      eosio::asset amount_collateral;
+      eosio::asset amount_borrowed;
+      eosio::asset amount_interest;
+      double interest_rate = 0;
+      uint32_t next_interest = 0;
+   };
+
+   /** Sums over all positions of a collateral **/
+   struct collateral_totals {
+      eosio::symbol symbol;
+      uint64_t positions = 0;
+      int64_t amount_collateral = 0;
+      int64_t amount_borrowed = 0;
+      int64_t amount_interest = 0;
+   };
+
+   /** Collateral row of the contract together with its rates and positions scopes **/
+   struct collateral {
+      eosio::symbol symbol;
+      eosio::name account;
+      bool exists = false;                      // Rates and positions outlive delcollater, as on chain
+      bool is_active = false;
+      double settlement_rate = 0;
+      double check_rate = 0;                    // Rate of the last liquidation check run by setrate
+
+      std::map<uint64_t, double> rates;         // By oracle, in rates table order
+      std::map<uint64_t, position> positions;   // By account, in positions table order
+      std::map<uint64_t, double> orders;        // Liquidation order rows (liqorders) by account, kept as the contract keeps them
+      collateral_totals totals;
+   };
+
+   class book {
+   public:
+      explicit book(eosio::name contract) : _contract(contract) {}
+
+      /** Apply a traced action, actions not changing the book are ignored **/
+      void apply(const trace_action& action);
+
+      /** Queries **/
+      const position* find_position(eosio::name user, eosio::symbol_code collateral) const;
+      eosio::asset get_debt(eosio::name user) const;
+      collateral_totals get_totals(eosio::symbol_code collateral) const;
+
+      eosio::name contract() const { return _contract; }
+      const std::map<uint64_t, std::string>& params() const { return _params; }
+      const std::map<uint64_t, collateral>& collaterals() const { return _collaterals; }
+
+      /** Trace bytes applied to the book, stored in snapshots to resume reading **/
+      uint64_t trace_offset = 0;
+
+   private:
+      friend class snapshot;
+
+      void setparam(const trace_action& action);
+      void addcollater(const trace_action& action);
+      void setcollater(const trace_action& action);
+      void delcollater(const trace_action& action);
+      void deloracle(const trace_action& action);
+      void setrate(const trace_action& action);
+      void setinterest(const trace_action& action);
+      void addinterest(const trace_action& action);
+      void liquidate(const trace_action& action);
+      void startsettle(const trace_action& action);
+      void settle(const trace_action& action);
+      void rebalance(const trace_action& action);
+      void reindex(const trace_action& action);
+      void transferzig(const trace_action& action);
+      void loan(const trace_action& action);
+
+      collateral& get_collateral(eosio::symbol_code code);
+      std::string get_param_string(eosio::name key) const;
+      std::string get_optional_param_string(eosio::name key) const;
+      double get_param_double(eosio::name key) const;
+      int get_param_int(eosio::name key) const;
+      double get_average_rate(const collateral& item) const;
+      bool accrue_interest(position& value, uint32_t time) const;
+      bool is_liquidation_due(const position& value, double rate, double threshold) const;
+      bool is_liquidation_mode_on() const;
+
+      /** Insert, replace or erase (nullopt) position, keeping totals and order rows up to date **/
+      void set_position(collateral& item, eosio::name account, const std::optional<position>& value);
+
+      eosio::name _contract;
+      std::map<uint64_t, std::string> _params;
+      std::map<uint64_t, collateral> _collaterals;
+   };
+}
@@ -0,0 +1,191 @@
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "book.hpp"
+#include "snapshot.hpp"
+#include "trace.hpp"
+#include "zigzag.common.hpp"
+
+/**
+ * Off-chain position indexer
+ *
+ * Usage: zigzag_indexer [options] [trace]
+ *
+ *    --contract <account>    Contract account (zigzag), must match the contract of the snapshot
+ *    --snapshot <file>       Start from snapshot if it exists, write checkpoints to it
+ *    --checkpoint <actions>  Write snapshot every <actions> applied actions (100000), 0 only on exit
+ *    --follow                Keep applying actions appended to the trace until interrupted
+ *    --user <account>        Print debt of the user (borrowed and interest of all positions)
+ *    --totals <symbol code>  Print totals of the collateral
+ *
+ * Without trace queries are answered straight from the mapped snapshot
+ **/
+
+namespace {
+
+   volatile std::sig_atomic_t stopped = 0;
+
+   void stop(int) {
+      stopped = 1;
+   }
+
+   struct options {
+      std::string trace;
+      std::string snapshot;
+      std::string contract = "zigzag";
+      bool has_contract = false;
+      uint64_t checkpoint = 100000;
+      bool follow = false;
+      std::vector<std::string> users;
+      std::vector<std::string> totals;
+   };
+
+   [[noreturn]] void usage() {
+      std::fprintf(stderr, "usage: zigzag_indexer [--contract <account>] [--snapshot <file>] [--checkpoint <actions>] [--follow]\n"
+         "                      [--user <account>]... [--totals <symbol code>]... [trace]\n");
+      std::exit(EXIT_FAILURE);
+   }
+
+   [[noreturn]] void invalid(const std::string& option, const std::string& value) {
+      std::fprintf(stderr, "error: invalid %s %s\n", option.c_str(), value.c_str());
+      std::exit(EXIT_FAILURE);
+   }
+
+   options parse_options(int argc, char** argv) {
+      options result;
+      for (int i = 1; i < argc; i++) {
+         std::string arg = argv[i];
+         auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+               usage();
+            }
+            return argv[++i];
+         };
+         if (arg == "--contract") {
+            result.contract = value();
+            result.has_contract = true;
+         } else if (arg == "--snapshot") {
+            result.snapshot = value();
+         } else if (arg == "--checkpoint") {
+            std::string checkpoint = value();
+            try {
+               if (checkpoint.empty() || !std::isdigit(static_cast<unsigned char>(checkpoint[0]))) {
+                  invalid(arg, checkpoint);
+               }
+               result.checkpoint = indexer::parse_uint(checkpoint);
+            } catch (const std::runtime_error&) {
+               invalid(arg, checkpoint);
+            }
+         } else if (arg == "--follow") {
+            result.follow = true;
+         } else if (arg == "--user") {
+            result.users.push_back(value());
+         } else if (arg == "--totals") {
+            result.totals.push_back(value());
+         } else if (arg.size() > 1 && arg[0] == '-') {
+            usage();
+         } else {
+            result.trace = arg;
+         }
+      }
+      if (result.trace.empty() && result.snapshot.empty()) {
+         usage();
+      }
+      return result;
+   }
+
+   /** Queries work the same way on the book and on the mapped snapshot **/
+   template <typename Source>
+   void print_queries(const Source& source, const options& opts) {
+      for (auto& user : opts.users) {
+         std::printf("%s debt %s\n", user.c_str(), source.get_debt(eosio::name(user)).to_string().c_str());
+      }
+      for (auto& code : opts.totals) {
+         auto totals = source.get_totals(eosio::symbol_code(code));
+         std::printf("%s %llu positions, %s collateral, %s borrowed, %s interest\n", code.c_str(),
+            (unsigned long long)totals.positions,
+            eosio::asset(totals.amount_collateral, totals.symbol).to_string().c_str(),
+            eosio::asset(totals.amount_borrowed, ZIG_SYMBOL).to_string().c_str(),
+            eosio::asset(totals.amount_interest, ZIG_SYMBOL).to_string().c_str());
+      }
+   }
+}
+
+int main(int argc, char** argv) {
+   const options opts = parse_options(argc, argv);
+
+   try {
+      /** Restart from the last checkpoint **/
+      std::unique_ptr<indexer::book> book;
+      bool has_snapshot = false;
+      if (!opts.snapshot.empty()) {
+         try {
+            indexer::snapshot mapped(opts.snapshot);
+            has_snapshot = true;
+
+            /** Snapshot of another contract is not replaced, it is an error in the options **/
+            if (opts.has_contract && eosio::name(mapped.header().contract) != eosio::name(opts.contract)) {
+               throw std::invalid_argument("snapshot " + opts.snapshot + " is of contract " + eosio::name(mapped.header().contract).to_string()
+                  + ", not " + opts.contract);
+            }
+            if (opts.trace.empty()) {
+               print_queries(mapped, opts);
+               return EXIT_SUCCESS;
+            }
+            book = std::make_unique<indexer::book>(mapped.load());
+         } catch (const std::runtime_error& e) {
+            if (opts.trace.empty()) {
+               throw;
+            }
+            std::fprintf(stderr, "%s, starting from the beginning of the trace\n", e.what());
+         }
+      }
+      if (!book) {
+         book = std::make_unique<indexer::book>(eosio::name(opts.contract));
+      }
+
+      std::signal(SIGINT, stop);
+      std::signal(SIGTERM, stop);
+
+      indexer::trace_reader reader(opts.trace, book->trace_offset);
+      indexer::trace_action action;
+      uint64_t applied = 0;
+      auto checkpoint = [&]() {
+         if (!opts.snapshot.empty()) {
+            indexer::snapshot::write(*book, opts.snapshot);
+         }
+      };
+
+      while (!stopped) {
+         while (!stopped && reader.next(action)) {
+            book->apply(action);
+            book->trace_offset = reader.offset();
+            applied++;
+            if (opts.checkpoint > 0 && applied % opts.checkpoint == 0) {
+               checkpoint();
+            }
+         }
+         if (!opts.follow) {
+            break;
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      }
+      checkpoint();
+
+      std::fprintf(stderr, "%llu actions applied%s\n", (unsigned long long)applied, has_snapshot ? " after snapshot" : "");
+      print_queries(*book, opts);
+   } catch (const std::exception& e) {
+      std::fprintf(stderr, "error: %s\n", e.what());
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
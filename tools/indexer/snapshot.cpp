@@ -0,0 +1,245 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "zigzag.common.hpp"
+
+namespace indexer {
+
+   using eosio::asset;
+   using eosio::name;
+   using eosio::symbol;
+   using eosio::symbol_code;
+
+   namespace {
+      const char MAGIC[8] = { 'Z', 'Z', 'I', 'N', 'D', 'E', 'X', '\0' };
+
+      bool position_less(const snapshot_position& position, const std::pair<uint64_t, uint64_t>& key) {
+         return position.code != key.first ? position.code < key.first : position.account < key.second;
+      }
+
+      template <typename T>
+      void append(std::vector<char>& buffer, const T& record) {
+         const char* bytes = reinterpret_cast<const char*>(&record);
+         buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+      }
+   }
+
+   void snapshot::write(const book& source, const std::string& path) {
+      snapshot_header header = {};
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.contract = source.contract().value;
+      header.trace_offset = source.trace_offset;
+
+      std::vector<char> params, collaterals, rates, positions, orders, strings;
+      for (auto& [key, value] : source.params()) {
+         append(params, snapshot_param{ key, strings.size(), value.size() });
+         strings.insert(strings.end(), value.begin(), value.end());
+         header.param_count++;
+      }
+      for (auto& [code, item] : source.collaterals()) {
+         snapshot_collateral record = {};
+         record.code = code;
+         record.symbol = item.symbol.raw();
+         record.account = item.account.value;
+         record.settlement_rate = item.settlement_rate;
+         record.check_rate = item.check_rate;
+         record.exists = item.exists;
+         record.is_active = item.is_active;
+         record.positions = item.totals.positions;
+         record.amount_collateral = item.totals.amount_collateral;
+         record.amount_borrowed = item.totals.amount_borrowed;
+         record.amount_interest = item.totals.amount_interest;
+         append(collaterals, record);
+         header.collateral_count++;
+
+         for (auto& [oracle, rate] : item.rates) {
+            append(rates, snapshot_rate{ code, oracle, rate });
+            header.rate_count++;
+         }
+         for (auto& [account, value] : item.positions) {
+            snapshot_position record = {};
+            record.code = code;
+            record.account = account;
+            record.collateral_symbol = value.amount_collateral.symbol.raw();
+            record.amount_collateral = value.amount_collateral.amount;
+            record.amount_borrowed = value.amount_borrowed.amount;
+            record.amount_interest = value.amount_interest.amount;
+            record.interest_rate = value.interest_rate;
+            record.next_interest = value.next_interest;
+            append(positions, record);
+            header.position_count++;
+         }
+         for (auto& [account, ratio] : item.orders) {
+            append(orders, snapshot_order{ code, account, ratio });
+            header.order_count++;
+         }
+      }
+
+      /** All records are multiples of 8 bytes, so every section stays aligned **/
+      header.param_offset = sizeof(snapshot_header);
+      header.collateral_offset = header.param_offset + params.size();
+      header.rate_offset = header.collateral_offset + collaterals.size();
+      header.position_offset = header.rate_offset + rates.size();
+      header.order_offset = header.position_offset + positions.size();
+      header.string_offset = header.order_offset + orders.size();
+      header.string_size = strings.size();
+
+      const std::string temp_path = path + ".tmp";
+      {
+         std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+         out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+         for (auto* section : { &params, &collaterals, &rates, &positions, &orders, &strings }) {
+            out.write(section->data(), section->size());
+         }
+         out.flush();
+         if (!out) {
+            throw std::runtime_error("can not write snapshot " + temp_path);
+         }
+      }
+      if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+         throw std::runtime_error("can not replace snapshot " + path);
+      }
+   }
+
+   snapshot::snapshot(const std::string& path) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+         throw std::runtime_error("can not open snapshot " + path);
+      }
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(snapshot_header)) {
+         ::close(fd);
+         throw std::runtime_error("snapshot " + path + " is truncated");
+      }
+      _size = st.st_size;
+      void* data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) {
+         throw std::runtime_error("can not map snapshot " + path);
+      }
+      _data = static_cast<const char*>(data);
+      _header = records<snapshot_header>(0);
+
+      auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+         return offset % 8 == 0 && offset <= _size && count <= (_size - offset) / size;
+      };
+      bool valid = std::memcmp(_header->magic, MAGIC, sizeof(MAGIC)) == 0
+         && _header->version == VERSION
+         && fits(_header->param_offset, _header->param_count, sizeof(snapshot_param))
+         && fits(_header->collateral_offset, _header->collateral_count, sizeof(snapshot_collateral))
+         && fits(_header->rate_offset, _header->rate_count, sizeof(snapshot_rate))
+         && fits(_header->position_offset, _header->position_count, sizeof(snapshot_position))
+         && fits(_header->order_offset, _header->order_count, sizeof(snapshot_order))
+         && _header->string_offset <= _size && _header->string_size <= _size - _header->string_offset;
+      if (!valid) {
+         ::munmap(const_cast<char*>(_data), _size);
+         throw std::runtime_error("snapshot " + path + " is invalid");
+      }
+   }
+
+   snapshot::~snapshot() {
+      ::munmap(const_cast<char*>(_data), _size);
+   }
+
+   const snapshot_position* snapshot::find_position(name user, symbol_code collateral) const {
+      const auto* begin = records<snapshot_position>(_header->position_offset);
+      const auto* end = begin + _header->position_count;
+      const auto* itr = std::lower_bound(begin, end, std::make_pair(collateral.raw(), user.value), position_less);
+      return itr != end && itr->code == collateral.raw() && itr->account == user.value ? itr : nullptr;
+   }
+
+   asset snapshot::get_debt(name user) const {
+      asset debt(0, ZIG_SYMBOL);
+      const auto* collaterals = records<snapshot_collateral>(_header->collateral_offset);
+      for (uint64_t i = 0; i < _header->collateral_count; i++) {
+         const auto* position = find_position(user, symbol_code(collaterals[i].code));
+         if (position != nullptr) {
+            debt += asset(position->amount_borrowed + position->amount_interest, ZIG_SYMBOL);
+         }
+      }
+      return debt;
+   }
+
+   collateral_totals snapshot::get_totals(symbol_code collateral) const {
+      const auto* begin = records<snapshot_collateral>(_header->collateral_offset);
+      const auto* end = begin + _header->collateral_count;
+      const auto* itr = std::lower_bound(begin, end, collateral.raw(), [](const snapshot_collateral& record, uint64_t code) {
+         return record.code < code;
+      });
+      if (itr == end || itr->code != collateral.raw()) {
+         return collateral_totals();
+      }
+      return collateral_totals{ symbol(itr->symbol), itr->positions, itr->amount_collateral, itr->amount_borrowed, itr->amount_interest };
+   }
+
+   book snapshot::load() const {
+      book result{ name(_header->contract) };
+      result.trace_offset = _header->trace_offset;
+
+      const char* strings = _data + _header->string_offset;
+      const auto* params = records<snapshot_param>(_header->param_offset);
+      for (uint64_t i = 0; i < _header->param_count; i++) {
+         if (params[i].value_offset > _header->string_size || params[i].value_size > _header->string_size - params[i].value_offset) {
+            throw std::runtime_error("snapshot param value is out of range");
+         }
+         result._params[params[i].key] = std::string(strings + params[i].value_offset, params[i].value_size);
+      }
+
+      const auto* collaterals = records<snapshot_collateral>(_header->collateral_offset);
+      for (uint64_t i = 0; i < _header->collateral_count; i++) {
+         auto& item = result._collaterals[collaterals[i].code];
+         item.symbol = symbol(collaterals[i].symbol);
+         item.account = name(collaterals[i].account);
+         item.exists = collaterals[i].exists;
+         item.is_active = collaterals[i].is_active;
+         item.settlement_rate = collaterals[i].settlement_rate;
+         item.check_rate = collaterals[i].check_rate;
+         item.totals = collateral_totals{
+            item.symbol,
+            collaterals[i].positions,
+            collaterals[i].amount_collateral,
+            collaterals[i].amount_borrowed,
+            collaterals[i].amount_interest
+         };
+      }
+
+      const auto* rates = records<snapshot_rate>(_header->rate_offset);
+      for (uint64_t i = 0; i < _header->rate_count; i++) {
+         auto& item_rates = result._collaterals[rates[i].code].rates;
+         item_rates.emplace_hint(item_rates.end(), rates[i].oracle, rates[i].rate);
+      }
+
+      /** Positions are sorted, so every insert goes to the end of its map **/
+      const auto* positions = records<snapshot_position>(_header->position_offset);
+      for (uint64_t i = 0; i < _header->position_count; i++) {
+         auto& item_positions = result._collaterals[positions[i].code].positions;
+         position value;
+         value.account = name(positions[i].account);
+         value.amount_collateral = asset(positions[i].amount_collateral, symbol(positions[i].collateral_symbol));
+         value.amount_borrowed = asset(positions[i].amount_borrowed, ZIG_SYMBOL);
+         value.amount_interest = asset(positions[i].amount_interest, ZIG_SYMBOL);
+         value.interest_rate = positions[i].interest_rate;
+         value.next_interest = positions[i].next_interest;
+         item_positions.emplace_hint(item_positions.end(), positions[i].account, value);
+      }
+
+      const auto* orders = records<snapshot_order>(_header->order_offset);
+      for (uint64_t i = 0; i < _header->order_count; i++) {
+         auto& item_orders = result._collaterals[orders[i].code].orders;
+         item_orders.emplace_hint(item_orders.end(), orders[i].account, orders[i].ratio);
+      }
+      return result;
+   }
+}
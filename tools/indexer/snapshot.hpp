@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "book.hpp"
+
+/**
+ * Binary snapshot of the position book
+ *
+ * File is a header followed by flat arrays of fixed size records, positions and order rows are
+ * sorted by (collateral, account). A mapped snapshot answers queries in place with binary search, and
+ * load() turns it back into a book without parsing anything, so restart takes one mmap and a copy.
+ * Records use host byte order, snapshots are not meant to be moved between architectures
+ **/
+namespace indexer {
+
+   struct snapshot_header {
+      char magic[8];
+      uint32_t version;
+      uint32_t reserved;
+      uint64_t contract;
+      uint64_t trace_offset;           // Trace bytes applied to the book
+      uint64_t param_count;
+      uint64_t param_offset;
+      uint64_t collateral_count;
+      uint64_t collateral_offset;
+      uint64_t rate_count;
+      uint64_t rate_offset;
+      uint64_t position_count;
+      uint64_t position_offset;
+      uint64_t order_count;
+      uint64_t order_offset;
+      uint64_t string_size;
+      uint64_t string_offset;          // Param values
+   };
+
+   struct snapshot_param {
+      uint64_t key;
+      uint64_t value_offset;
+      uint64_t value_size;
+   };
+
+   struct snapshot_collateral {
+      uint64_t code;
+      uint64_t symbol;
+      uint64_t account;
+      double settlement_rate;
+      double check_rate;
+      uint8_t exists;
+      uint8_t is_active;
+      uint8_t reserved[6];
+      uint64_t positions;
+      int64_t amount_collateral;
+      int64_t amount_borrowed;
+      int64_t amount_interest;
+   };
+
+   struct snapshot_rate {
+      uint64_t code;
+      uint64_t oracle;
+      double rate;
+   };
+
+   struct snapshot_position {
+      uint64_t code;
+      uint64_t account;
+      uint64_t collateral_symbol;
+      int64_t amount_collateral;
+      int64_t amount_borrowed;
+      int64_t amount_interest;
+      double interest_rate;
+      uint32_t next_interest;
+      uint32_t reserved;
+   };
+
+   struct snapshot_order {
+      uint64_t code;
+      uint64_t account;
+      double ratio;
+   };
+
+   /** Read only mapping of a snapshot file **/
+   class snapshot {
+   public:
+      static constexpr uint32_t VERSION = 4;
+
+      /** Write book to path atomically (temporary file and rename) **/
+      static void write(const book& source, const std::string& path);
+
+      /** Map snapshot file, throws std::runtime_error if it is missing or invalid **/
+      explicit snapshot(const std::string& path);
+      ~snapshot();
+      snapshot(const snapshot&) = delete;
+      snapshot& operator=(const snapshot&) = delete;
+
+      const snapshot_header& header() const { return *_header; }
+
+      /** Same queries as book, answered from the mapped records **/
+      const snapshot_position* find_position(eosio::name user, eosio::symbol_code collateral) const;
+      eosio::asset get_debt(eosio::name user) const;
+      collateral_totals get_totals(eosio::symbol_code collateral) const;
+
+      /** Book with the mapped state **/
+      book load() const;
+
+   private:
+      template <typename T>
+      const T* records(uint64_t offset) const {
+         return reinterpret_cast<const T*>(_data + offset);
+      }
+
+      const char* _data = nullptr;
+      size_t _size = 0;
+      const snapshot_header* _header = nullptr;
+   };
+}
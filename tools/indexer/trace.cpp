@@ -0,0 +1,173 @@
+#include "trace.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace indexer {
+
+   namespace {
+      const char SEPARATOR = '\t';
+
+      [[noreturn]] void malformed(const std::string& what, const std::string& str) {
+         throw std::runtime_error("malformed " + what + " \"" + str + "\"");
+      }
+      /** Fields are user controlled (transfer memos), separator, line end and escape character are escaped **/
+      void append_escaped(std::string& line, const std::string& field) {
+         for (char c : field) {
+            switch (c) {
+               case '\\': line += "\\\\"; break;
+               case '\t':  line += "\\t"; break;
+               case '\n':  line += "\\n"; break;
+               case '\r':  line += "\\r"; break;
+               default:    line += c; break;
+            }
+         }
+      }
+
+      std::string unescape(const std::string& field, const std::string& line) {
+         std::string result;
+         result.reserve(field.size());
+         for (size_t i = 0; i < field.size(); i++) {
+            if (field[i] != '\\') {
+               result += field[i];
+               continue;
+            }
+            if (++i == field.size()) {
+               malformed("trace line", line);
+            }
+            switch (field[i]) {
+               case '\\': result += '\\'; break;
+               case 't':  result += '\t'; break;
+               case 'n':  result += '\n'; break;
+               case 'r':  result += '\r'; break;
+               default:   malformed("trace line", line);
+            }
+         }
+         return result;
+      }
+   }
+
+   std::string format_trace_line(const trace_action& action) {
+      std::string line = std::to_string(action.time);
+      line += SEPARATOR;
+      line += action.code.to_string();
+      line += SEPARATOR;
+      line += action.action.to_string();
+      for (auto& arg : action.args) {
+         line += SEPARATOR;
+         append_escaped(line, arg);
+      }
+      return line;
+   }
+
+   trace_action parse_trace_line(const std::string& line) {
+      std::vector<std::string> fields;
+      size_t start = 0;
+      while (true) {
+         size_t end = line.find(SEPARATOR, start);
+         fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+         if (end == std::string::npos) {
+            break;
+         }
+         start = end + 1;
+      }
+      if (fields.size() < 3) {
+         malformed("trace line", line);
+      }
+
+      trace_action action;
+      action.time = uint32_t(parse_uint(fields[0]));
+      action.code = eosio::name(fields[1]);
+      action.action = eosio::name(fields[2]);
+      for (size_t i = 3; i < fields.size(); i++) {
+         action.args.push_back(unescape(fields[i], line));
+      }
+      return action;
+   }
+
+   std::string format_double(double value) {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+      return buffer;
+   }
+
+   double parse_double(const std::string& str) {
+      char* end = nullptr;
+      errno = 0;
+      double value = std::strtod(str.c_str(), &end);
+      if (str.empty() || *end != '\0' || errno != 0) {
+         malformed("number", str);
+      }
+      return value;
+   }
+
+   uint64_t parse_uint(const std::string& str) {
+      char* end = nullptr;
+      errno = 0;
+      uint64_t value = std::strtoull(str.c_str(), &end, 10);
+      if (str.empty() || *end != '\0' || errno != 0) {
+         malformed("number", str);
+      }
+      return value;
+   }
+
+   eosio::symbol parse_symbol(const std::string& str) {
+      size_t comma = str.find(',');
+      if (comma == std::string::npos) {
+         malformed("symbol", str);
+      }
+      uint64_t precision = parse_uint(str.substr(0, comma));
+      if (precision > 18) {
+         malformed("symbol", str);
+      }
+      return eosio::symbol(str.substr(comma + 1), uint8_t(precision));
+   }
+
+   eosio::asset parse_asset(const std::string& str) {
+      size_t space = str.find(' ');
+      if (space == std::string::npos || space == 0) {
+         malformed("asset", str);
+      }
+      std::string amount = str.substr(0, space);
+      bool negative = amount[0] == '-';
+      if (negative) {
+         amount.erase(0, 1);
+      }
+
+      /** Precision is the number of digits after the point **/
+      size_t point = amount.find('.');
+      uint8_t precision = 0;
+      if (point != std::string::npos) {
+         precision = uint8_t(amount.size() - point - 1);
+         amount.erase(point, 1);
+      }
+      int64_t value = int64_t(parse_uint(amount));
+      return eosio::asset(negative ? -value : value, eosio::symbol(str.substr(space + 1), precision));
+   }
+
+   trace_reader::trace_reader(const std::string& path, uint64_t offset)
+      : _stream(path, std::ios::binary), _offset(offset) {
+      if (!_stream.is_open()) {
+         throw std::runtime_error("can not open trace " + path);
+      }
+   }
+
+   bool trace_reader::next(trace_action& action) {
+      if (_seek) {
+         _stream.clear();
+         _stream.seekg(std::streamoff(_offset));
+         _seek = false;
+      }
+
+      /** Line without newline at the end of file is still being written **/
+      if (!std::getline(_stream, _line) || _stream.eof()) {
+         _seek = true;
+         return false;
+      }
+      _offset += _line.size() + 1;
+      action = parse_trace_line(_line);
+      return true;
+   }
+}
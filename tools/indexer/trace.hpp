@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <eosio/asset.hpp>
+#include <eosio/name.hpp>
+#include <eosio/symbol.hpp>
+
+/**
+ * File based action trace, a stand-in for a state history or trace API feed
+ *
+ * One committed action executed by the contract per line, in execution order:
+ *
+ *    <block time sec> \t <code> \t <action> \t <arg> \t <arg> ...
+ *
+ * code is the account of the action (contract account, or token account for transfer notifications).
+ * Arguments use their chain string form: names as is, symbols as "4,EOS", assets as "1.0000 EOS",
+ * doubles with 17 significant digits so they are read back exactly. Backslash, tab, newline and
+ * carriage return in arguments (transfer memos) are written as \\, \t, \n and \r. Failed transactions are not traced
+ **/
+namespace indexer {
+
+   struct trace_action {
+      uint32_t time = 0;
+      eosio::name code;
+      eosio::name action;
+      std::vector<std::string> args;
+   };
+
+   std::string format_trace_line(const trace_action& action);
+   trace_action parse_trace_line(const std::string& line);
+
+   /** Argument conversions, parse functions throw std::runtime_error on malformed values **/
+   std::string format_double(double value);
+   double parse_double(const std::string& str);
+   uint64_t parse_uint(const std::string& str);
+   eosio::symbol parse_symbol(const std::string& str);
+   eosio::asset parse_asset(const std::string& str);
+
+   /**
+    * Reads complete lines appended to the trace file
+    * Offset of the first unread byte is kept, so reading can be resumed after restart
+    **/
+   class trace_reader {
+   public:
+      explicit trace_reader(const std::string& path, uint64_t offset = 0);
+
+      /** Next action, false if there is no complete line yet (file can still grow) **/
+      bool next(trace_action& action);
+      uint64_t offset() const { return _offset; }
+
+   private:
+      std::ifstream _stream;
+      std::string _line;
+      uint64_t _offset;
+      bool _seek = true;
+   };
+}
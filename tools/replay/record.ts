@@ -0,0 +1,80 @@
+import * as Eos from 'eosjs';
+
+import { Session, RecordedAction, actionKind, parseArgs, saveSession } from './session';
+
+/**
+ * Records contract traffic from a node with the history plugin
+ *
+ * Usage: ts-node tools/replay/record.ts --url <endpoint> --out <session.json>
+ *           [--contract zigzag] [--from <account seq>] [--to <account seq>]
+ *
+ * Kept actions are the ones sent to the contract from outside: collateral transfers (loan), ZIG
+ * transfers (transferzig), setrate and liquidate. Notifications are deduplicated by global
+ * sequence, transfers sent by the contract itself are dropped.
+ */
+
+const PAGE = 100;
+const KINDS = ['loan', 'transferzig', 'setrate', 'liquidate'];
+
+async function main() {
+  const args = parseArgs(process.argv.slice(2));
+  if (!args.url || !args.out) {
+    throw new Error('usage: record.ts --url <endpoint> --out <session.json> [--contract zigzag] [--from <seq>] [--to <seq>]');
+  }
+  const contract = args.contract ? args.contract[0] : 'zigzag';
+  const to = args.to ? Number(args.to[0]) : Infinity;
+
+  const eos = Eos({ httpEndpoint: args.url[0], verbose: false });
+  const seen = new Set<number>();
+  const actions: RecordedAction[] = [];
+
+  for (let pos = args.from ? Number(args.from[0]) : 0; pos <= to; pos += PAGE) {
+    const page = await eos.getActions({ account_name: contract, pos, offset: PAGE - 1 });
+    for (const item of page.actions) {
+      const trace = item.action_trace;
+      if (item.account_action_seq > to || trace.receipt.receiver !== contract || seen.has(trace.receipt.global_sequence)) {
+        continue;
+      }
+      seen.add(trace.receipt.global_sequence);
+
+      const act = trace.act;
+      if (act.name === 'transfer' && (act.data.to !== contract || act.data.from === contract)) {
+        continue;
+      }
+      const action: RecordedAction = {
+        seq: item.account_action_seq,
+        block_num: item.block_num,
+        block_time: item.block_time,
+        trx_id: trace.trx_id,
+        account: act.account,
+        name: act.name,
+        authorization: act.authorization,
+        data: act.data,
+      };
+      if ((act.name === 'transfer' || act.account === contract) && KINDS.indexOf(actionKind(action)) >= 0) {
+        actions.push(action);
+      }
+    }
+    process.stdout.write(`==> ${pos + page.actions.length} account actions read, ${actions.length} recorded\n`);
+    if (page.actions.length < PAGE) {
+      break;
+    }
+  }
+
+  const session: Session = {
+    endpoint: args.url[0],
+    contract,
+    recorded_at: new Date().toISOString(),
+    actions,
+  };
+  saveSession(args.out[0], session);
+
+  const counts: { [kind: string]: number } = {};
+  actions.forEach(action => (counts[actionKind(action)] = (counts[actionKind(action)] || 0) + 1));
+  console.log(`Recorded ${actions.length} actions to ${args.out[0]}:`, counts);
+}
+
+main().catch(e => {
+  console.error(e.message || e);
+  process.exit(1);
+});
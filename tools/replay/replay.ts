@@ -0,0 +1,352 @@
+import * as fs from 'fs';
+import Big from 'big.js';
+import { spawn } from 'child_process';
+
+import { Session, RecordedAction, CleosError, actionKind, cleos, cleosJson, loadSession, parseArgs } from './session';
+
+/**
+ * Replays a recorded session against two contract builds and compares them
+ *
+ * Usage: ts-node tools/replay/replay.ts --session <session.json> --base <build dir> --candidate <build dir>
+ *           [--out <report.json>] [--cpu-tolerance <percent>] [--ignore <table>[.<field>]]...
+ *        ts-node tools/replay/replay.ts --smoke [<actions>] --session <session.json> --candidate <build dir>
+ *
+ * Every build gets a fresh local node from scripts/node-start.sh with its zigzag.wasm published.
+ * Recorded accounts are created and funded, recorded oracles and the liquidate caller are
+ * registered, then actions are pushed one by one in recorded order. CPU and NET are taken from the
+ * transaction receipt, RAM is the change of contract and actor RAM usage. After the last action
+ * all contract tables are dumped.
+ *
+ * Divergence is any difference in action outcome (error, inline actions) or table rows. Exits with
+ * 1 on divergence or when the candidate uses more NET or RAM than the base, or more CPU than the
+ * base plus the tolerance (10% by default, CPU time is noisy).
+ *
+ * Smoke run prepares the node of the candidate build only and replays the first actions (all by
+ * default). Recorded actions succeeded on chain, so it exits with 1 when preparation or any action fails.
+ */
+
+const NODE_START = './scripts/node-start.sh';
+const NODE_STOP = './scripts/node-stop.sh';
+
+/** Replay accounts get the local eosio key, which is in the wallet unlocked by node-start.sh */
+const REPLAY_KEY = 'EOS6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV';
+
+/** Block time dependent fields and build dependent tables are not compared by default */
+const DEFAULT_IGNORE = ['positions.next_interest', 'stats'];
+
+interface ActionResult {
+  index: number;
+  kind: string;
+  actor: string;
+  ok: boolean;
+  error?: string;
+  cpu: number;
+  net: number;
+  ram: number;
+  inline: string[];
+}
+
+interface Run {
+  build: string;
+  results: ActionResult[];
+  tables: { [key: string]: any[] };
+}
+
+interface Divergence {
+  index?: number;
+  table?: string;
+  base: string;
+  candidate: string;
+}
+
+function runScript(path: string, env: NodeJS.ProcessEnv): Promise<void> {
+  return new Promise((resolve, reject) => {
+    const cmd = spawn(path, [], { env });
+    cmd.stdout.on('data', data => process.stdout.write(`==> ${data.toString().trimRight()}\n`));
+    cmd.stderr.on('data', data => process.stdout.write(`!!! ${data.toString().trimRight()}\n`));
+    cmd.on('error', reject);
+    cmd.on('close', code => (code === 0 ? resolve() : reject(new Error(`${path} exited with ${code}`))));
+  });
+}
+
+async function accountExists(account: string) {
+  try {
+    await cleos(['get', 'account', account, '-j']);
+    return true;
+  } catch (e) {
+    return false;
+  }
+}
+
+async function ramUsage(account: string): Promise<number> {
+  return (await cleosJson(['get', 'account', account, '-j'])).ram_usage;
+}
+
+async function pushAction(account: string, name: string, data: any, actor: string, permission: string = 'active') {
+  return cleosJson(['push', 'action', account, name, JSON.stringify(data), '-p', `${actor}@${permission}`, '-j', '-f']);
+}
+
+/** Oracles already on the node, builds before collateral ids keep them in oracles, later ones in oraclemasks */
+async function registeredOracles(contract: string): Promise<string[]> {
+  const tables = (await cleosJson(['get', 'abi', contract])).abi.tables.map(t => t.name);
+  const registered: string[] = [];
+  for (const table of ['oraclemasks', 'oracles'].filter(t => tables.indexOf(t) >= 0)) {
+    const rows = (await cleosJson(['get', 'table', contract, contract, table, '-l', '1000'])).rows;
+    registered.push(...rows.map(row => row.account));
+  }
+  return registered;
+}
+
+/** Make recorded accounts, balances, oracles and the liquidate caller exist on the local node */
+async function prepare(session: Session) {
+  const contract = session.contract;
+
+  const accounts = new Set<string>();
+  session.actions.forEach(action => action.authorization.forEach(auth => accounts.add(auth.actor)));
+  for (const account of Array.from(accounts)) {
+    if (!(await accountExists(account))) {
+      await cleos(['create', 'account', 'eosio', account, REPLAY_KEY, '-p', 'eosio@active']);
+    }
+  }
+
+  /** Everybody gets what they transfer in the session, tokens not deployed locally are skipped */
+  const funding = new Map<string, ReturnType<typeof Big>>();
+  for (const action of session.actions.filter(a => a.name === 'transfer')) {
+    const [amount, symbol] = action.data.quantity.split(' ');
+    const key = [action.account, action.data.from, symbol, amount.split('.')[1] || ''].join(' ');
+    funding.set(key, (funding.get(key) || Big(0)).plus(amount));
+  }
+  for (const [key, total] of Array.from(funding.entries())) {
+    const [token, account, symbol, decimals] = key.split(' ');
+    let issuer: string | undefined;
+    try {
+      issuer = (await cleosJson(['get', 'currency', 'stats', token, symbol]))[symbol].issuer;
+    } catch (e) {}
+    if (!issuer) {
+      console.log(`No ${symbol} on ${token}, transfers of ${account} will fail on both builds`);
+      continue;
+    }
+    const quantity = `${total.toFixed(decimals.length)} ${symbol}`;
+    await pushAction(token, 'issue', [account, quantity, 'Replay funding'], issuer);
+  }
+
+  /** Recorded oracles are added for the collaterals they set rates for */
+  const oracles = new Map<string, Set<string>>();
+  for (const action of session.actions.filter(a => a.account === contract && a.name === 'setrate')) {
+    oracles.set(action.data.oracle, (oracles.get(action.data.oracle) || new Set<string>()).add(action.data.collateral));
+  }
+  const registered = await registeredOracles(contract);
+  for (const [oracle, collaterals] of Array.from(oracles.entries())) {
+    if (registered.indexOf(oracle) < 0) {
+      await pushAction(contract, 'addoracle', [oracle, Array.from(collaterals)], contract);
+    }
+  }
+
+  const liquidator = session.actions.find(a => a.account === contract && a.name === 'liquidate');
+  if (liquidator && liquidator.authorization[0].actor !== contract) {
+    await pushAction(contract, 'setparam', ['cron.account', liquidator.authorization[0].actor], contract);
+  }
+}
+
+/** Inline actions sent by the action, notifications are left out */
+function inlineActions(traces: any[]): string[] {
+  const result: string[] = [];
+  const walk = (trace: any, depth: number) => {
+    if (depth > 0 && trace.receipt.receiver === trace.act.account) {
+      result.push(`${trace.act.account}::${trace.act.name} ${JSON.stringify(trace.act.data)}`);
+    }
+    (trace.inline_traces || []).forEach(inline => walk(inline, depth + 1));
+  };
+  traces.forEach(trace => walk(trace, 0));
+  return result;
+}
+
+async function replayAction(contract: string, action: RecordedAction, index: number): Promise<ActionResult> {
+  const auth = action.authorization[0];
+  const result: ActionResult = { index, kind: actionKind(action), actor: auth.actor, ok: true, cpu: 0, net: 0, ram: 0, inline: [] };
+
+  const ramBefore = (await ramUsage(contract)) + (await ramUsage(auth.actor));
+  try {
+    const processed = (await pushAction(action.account, action.name, action.data, auth.actor, auth.permission)).processed;
+    result.cpu = processed.receipt.cpu_usage_us;
+    result.net = processed.receipt.net_usage_words * 8;
+    result.inline = inlineActions(processed.action_traces);
+  } catch (e) {
+    if (!(e instanceof CleosError)) {
+      throw e;
+    }
+    result.ok = false;
+    result.error = CleosError.assertion(e.stderr);
+  }
+  result.ram = (await ramUsage(contract)) + (await ramUsage(auth.actor)) - ramBefore;
+  return result;
+}
+
+async function dumpTables(contract: string): Promise<{ [key: string]: any[] }> {
+  const tables: { [key: string]: any[] } = {};
+  const abi = (await cleosJson(['get', 'abi', contract])).abi;
+  for (const table of abi.tables.map(t => t.name)) {
+    const scopes = (await cleosJson(['get', 'scope', contract, '-t', table, '-l', '10000'])).rows;
+    for (const scope of scopes.map(s => s.scope)) {
+      tables[`${table}/${scope}`] = (await cleosJson(['get', 'table', contract, scope, table, '-l', '100000'])).rows;
+    }
+  }
+  return tables;
+}
+
+async function run(session: Session, build: string, count: number = session.actions.length): Promise<Run> {
+  console.log(`Replaying ${count} actions on ${build}`);
+  await runScript(NODE_START, Object.assign({}, process.env, { ZIGZAG_BUILD: build }));
+  try {
+    await prepare(session);
+    const results: ActionResult[] = [];
+    for (let i = 0; i < count; i++) {
+      results.push(await replayAction(session.contract, session.actions[i], i));
+    }
+    return { build, results, tables: await dumpTables(session.contract) };
+  } finally {
+    await runScript(NODE_STOP, process.env);
+  }
+}
+
+function stripIgnored(table: string, rows: any[], ignore: string[]) {
+  const fields = ignore.filter(i => i.startsWith(`${table}.`)).map(i => i.substring(table.length + 1));
+  return rows.map(row => {
+    const copy = Object.assign({}, row);
+    fields.forEach(field => delete copy[field]);
+    return JSON.stringify(copy);
+  });
+}
+
+function compare(base: Run, candidate: Run, ignore: string[]): Divergence[] {
+  const divergences: Divergence[] = [];
+
+  base.results.forEach((a, i) => {
+    const b = candidate.results[i];
+    const outcome = (r: ActionResult) => (r.ok ? `ok ${r.inline.join(', ')}` : `failed: ${r.error}`);
+    if (outcome(a) !== outcome(b)) {
+      divergences.push({ index: i, base: outcome(a), candidate: outcome(b) });
+    }
+  });
+
+  const keys = new Set(Object.keys(base.tables).concat(Object.keys(candidate.tables)));
+  for (const key of Array.from(keys).sort()) {
+    const table = key.split('/')[0];
+    if (ignore.indexOf(table) >= 0) {
+      continue;
+    }
+    const a = stripIgnored(table, base.tables[key] || [], ignore);
+    const b = stripIgnored(table, candidate.tables[key] || [], ignore);
+    for (let i = 0; i < Math.max(a.length, b.length); i++) {
+      if (a[i] !== b[i]) {
+        divergences.push({ table: key, base: a[i] || 'no row', candidate: b[i] || 'no row' });
+      }
+    }
+  }
+  return divergences;
+}
+
+function sum(results: ActionResult[], field: 'cpu' | 'net' | 'ram') {
+  return results.reduce((total, r) => total + r[field], 0);
+}
+
+function delta(a: number, b: number) {
+  const sign = b >= a ? '+' : '';
+  return a === 0 ? `${sign}${b - a}` : `${sign}${b - a} (${sign}${(((b - a) / a) * 100).toFixed(1)}%)`;
+}
+
+function report(session: Session, base: Run, candidate: Run, divergences: Divergence[]) {
+  console.log('\nPer action (base -> candidate): cpu us, net bytes, ram bytes');
+  base.results.forEach((a, i) => {
+    const b = candidate.results[i];
+    const status = a.ok && b.ok ? '' : ` [${a.ok ? 'ok' : 'failed'} -> ${b.ok ? 'ok' : 'failed'}]`;
+    console.log(
+      `#${i} ${a.kind} ${a.actor}: cpu ${a.cpu} -> ${b.cpu}, net ${a.net} -> ${b.net}, ram ${a.ram} -> ${b.ram}${status}`,
+    );
+  });
+
+  console.log('\nBy action');
+  const kinds = Array.from(new Set(base.results.map(r => r.kind)));
+  for (const kind of kinds) {
+    const a = base.results.filter(r => r.kind === kind && r.ok);
+    const b = candidate.results.filter(r => r.kind === kind && r.ok);
+    console.log(
+      `${kind} (${a.length} succeeded): cpu ${delta(sum(a, 'cpu'), sum(b, 'cpu'))}, ` +
+        `net ${delta(sum(a, 'net'), sum(b, 'net'))}, ram ${delta(sum(a, 'ram'), sum(b, 'ram'))}`,
+    );
+  }
+
+  console.log(`\n${divergences.length} divergences`);
+  divergences.forEach(d => {
+    console.log(d.table !== undefined ? `table ${d.table}:` : `#${d.index} ${actionKind(session.actions[d.index!])}:`);
+    console.log(`  base:      ${d.base}`);
+    console.log(`  candidate: ${d.candidate}`);
+  });
+}
+
+/** Candidate build alone, catches a node it can not be prepared on before the full comparison */
+async function smoke(session: Session, build: string, count: number) {
+  const candidate = await run(session, build, Math.min(count, session.actions.length));
+  const failed = candidate.results.filter(r => !r.ok);
+  failed.forEach(r => console.log(`#${r.index} ${r.kind} ${r.actor}: failed: ${r.error}`));
+  console.log(
+    failed.length === 0
+      ? `\nSmoke run passed, ${candidate.results.length} actions`
+      : `\nFAILED: ${failed.length} of ${candidate.results.length} actions`,
+  );
+  process.exit(failed.length === 0 ? 0 : 1);
+}
+
+async function main() {
+  const args = parseArgs(process.argv.slice(2));
+  if (args.smoke) {
+    if (!args.session || !args.candidate) {
+      throw new Error('usage: replay.ts --smoke [<actions>] --session <session.json> --candidate <build dir>');
+    }
+    const count = args.smoke[0] === 'true' ? Infinity : Number(args.smoke[0]);
+    if (!(count > 0)) {
+      throw new Error(`Invalid smoke action count ${args.smoke[0]}`);
+    }
+    return smoke(loadSession(args.session[0]), args.candidate[0], count);
+  }
+  if (!args.session || !args.base || !args.candidate) {
+    throw new Error(
+      'usage: replay.ts --session <session.json> --base <build dir> --candidate <build dir> ' +
+        '[--out <report.json>] [--cpu-tolerance <percent>] [--ignore <table>[.<field>]]...',
+    );
+  }
+  const session = loadSession(args.session[0]);
+  const tolerance = args['cpu-tolerance'] ? Number(args['cpu-tolerance'][0]) : 10;
+  const ignore = DEFAULT_IGNORE.concat(args.ignore || []);
+
+  const base = await run(session, args.base[0]);
+  const candidate = await run(session, args.candidate[0]);
+  const divergences = compare(base, candidate, ignore);
+  report(session, base, candidate, divergences);
+  if (args.out) {
+    fs.writeFileSync(args.out[0], JSON.stringify({ base, candidate, divergences }, null, 2));
+  }
+
+  const succeeded = (r: Run) => r.results.filter(x => x.ok);
+  const [a, b] = [succeeded(base), succeeded(candidate)];
+  const failures: string[] = [];
+  if (divergences.length > 0) {
+    failures.push('behaviour diverged');
+  }
+  if (sum(b, 'net') > sum(a, 'net')) {
+    failures.push('candidate uses more NET');
+  }
+  if (sum(b, 'ram') > sum(a, 'ram')) {
+    failures.push('candidate uses more RAM');
+  }
+  if (sum(b, 'cpu') > sum(a, 'cpu') * (1 + tolerance / 100)) {
+    failures.push(`candidate uses more than ${tolerance}% more CPU`);
+  }
+  console.log(failures.length === 0 ? '\nCandidate is no more expensive than base' : `\nFAILED: ${failures.join(', ')}`);
+  process.exit(failures.length === 0 ? 0 : 1);
+}
+
+main().catch(e => {
+  console.error(e.message || e);
+  process.exit(1);
+});
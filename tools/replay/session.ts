@@ -0,0 +1,88 @@
+import * as fs from 'fs';
+import { execFile } from 'child_process';
+
+/**
+ * Recorded session format shared by record.ts and replay.ts
+ */
+
+export const ZIG_CONTRACT = 'zigtokenhome';
+
+export interface RecordedAction {
+  seq: number;
+  block_num: number;
+  block_time: string;
+  trx_id: string;
+  account: string;
+  name: string;
+  authorization: { actor: string; permission: string }[];
+  data: any;
+}
+
+export interface Session {
+  endpoint: string;
+  contract: string;
+  recorded_at: string;
+  actions: RecordedAction[];
+}
+
+export function loadSession(path: string): Session {
+  return JSON.parse(fs.readFileSync(path).toString());
+}
+
+export function saveSession(path: string, session: Session) {
+  fs.writeFileSync(path, JSON.stringify(session, null, 2));
+}
+
+/** Short form used in reports: "loan", "transferzig", "setrate", "liquidate" */
+export function actionKind(action: RecordedAction): string {
+  if (action.name === 'transfer') {
+    return action.account === ZIG_CONTRACT ? 'transferzig' : 'loan';
+  }
+  return action.name;
+}
+
+/** Command line options in --key value form, repeated keys are collected */
+export function parseArgs(argv: string[]): { [key: string]: string[] } {
+  const result: { [key: string]: string[] } = {};
+  for (let i = 0; i < argv.length; i++) {
+    const match = /^--(.+)$/.exec(argv[i]);
+    if (!match) {
+      throw new Error(`Unexpected argument ${argv[i]}`);
+    }
+    const value = i + 1 < argv.length && !argv[i + 1].startsWith('--') ? argv[++i] : 'true';
+    (result[match[1]] = result[match[1]] || []).push(value);
+  }
+  return result;
+}
+
+export class CleosError extends Error {
+  constructor(readonly args: string[], readonly stderr: string) {
+    super(`cleos ${args.join(' ')}: ${CleosError.assertion(stderr)}`);
+  }
+
+  /** Contract assertion message if there is one, first error line otherwise */
+  static assertion(stderr: string): string {
+    const match = /assertion failure with message: (.*)/.exec(stderr);
+    if (match) {
+      return match[1].trim();
+    }
+    const line = stderr.split('\n').find(l => /error/i.test(l));
+    return (line || stderr).trim();
+  }
+}
+
+export async function cleos(args: string[], env?: NodeJS.ProcessEnv): Promise<string> {
+  return new Promise((resolve, reject) => {
+    execFile('cleos', args, { env: env || process.env, maxBuffer: 64 * 1024 * 1024 }, (error, stdout, stderr) => {
+      if (error) {
+        reject(new CleosError(args, stderr.toString()));
+        return;
+      }
+      resolve(stdout.toString());
+    });
+  });
+}
+
+export async function cleosJson(args: string[]): Promise<any> {
+  return JSON.parse(await cleos(args));
+}